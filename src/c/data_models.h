@@ -1,48 +1,65 @@
 #pragma once
 
+#include "string_arena.h"
 #include <pebble.h>
 
 // Maximum sizes for data strings
 #define MAX_TITLE_LENGTH 64
-#define MAX_SUBTITLE_LENGTH 64
-#define MAX_EXTRA_LENGTH 32
 
-// Data models
+// Display strings are built once when a dataset is parsed so draw callbacks
+// only have to draw them
+#define POSITION_TEXT_LENGTH 4
+#define POINTS_TEXT_LENGTH 6
+#define SHORT_NAME_LENGTH 16
+#define TIME_TEXT_LENGTH 16
+
+// Data models. Variable-length strings live in the owning window's
+// StringArena and are held here by offset; drivers and constructors are
+// referenced by dictionary id (see dictionary.h). Windows allocate one of
+// these per row on the heap (see record_buffer.h), so the asserts below pin
+// each record's size.
 typedef struct {
-  char name[MAX_TITLE_LENGTH];
-  char location[MAX_SUBTITLE_LENGTH];
-  char date[MAX_EXTRA_LENGTH]; // ISO format date
-  int index;
-  int round; // Round number in the season (1-24)
+  uint32_t date;      // Midnight UTC of the race day, epoch seconds
+  ArenaString name;
+  ArenaString location;
+  uint8_t round;      // Round number in the season (1-24)
+  char round_text[POSITION_TEXT_LENGTH];
 } Race;
 
 typedef struct {
-  char label[MAX_TITLE_LENGTH];
-  char datetime[MAX_SUBTITLE_LENGTH]; // ISO format datetime
-  int index;
+  uint32_t start_time;                // UTC start of the session, epoch seconds
+  ArenaString label;
+  char time_text[TIME_TEXT_LENGTH];   // Local start time for the row
 } RaceEvent;
 
 typedef struct {
-  char name[MAX_TITLE_LENGTH];     // Full name (first + last)
-  char code[4];                     // Driver code (e.g., "NOR")
-  int points;
-  int position;
-  int index;
+  uint16_t points;    // Tenths of a point, as half points are awarded
+  uint8_t driver_id;
+  uint8_t position;
+  char position_text[POSITION_TEXT_LENGTH];
+  char points_text[POINTS_TEXT_LENGTH];
 } DriverStanding;
 
 typedef struct {
-  char name[MAX_TITLE_LENGTH];
-  char time[MAX_SUBTITLE_LENGTH];
-  int position;
-  int index;
+  ArenaString time;
+  uint8_t driver_id;
+  uint8_t position;
+  char position_text[POSITION_TEXT_LENGTH];
 } QualifyingResult;
 
 typedef struct {
-  char name[MAX_TITLE_LENGTH];
-  int points;
-  int position;
-  int index;
+  uint16_t points;    // Tenths of a point
+  uint8_t team_id;
+  uint8_t position;
+  char position_text[POSITION_TEXT_LENGTH];
+  char points_text[POINTS_TEXT_LENGTH];
 } ConstructorStanding;
 
+_Static_assert(sizeof(Race) == 16, "Race record grew");
+_Static_assert(sizeof(RaceEvent) == 24, "RaceEvent record grew");
+_Static_assert(sizeof(DriverStanding) == 14, "DriverStanding record grew");
+_Static_assert(sizeof(QualifyingResult) == 8, "QualifyingResult record grew");
+_Static_assert(sizeof(ConstructorStanding) == 14, "ConstructorStanding record grew");
+
 // Global season
 extern int g_current_season;
@@ -0,0 +1,375 @@
+#include "dataset_cache.h"
+#include "data_models.h"
+#include "storage.h"
+#include <pebble.h>
+
+// Cached payloads older than this are ignored rather than shown as stale
+#define DATASET_CACHE_MAX_AGE (14 * 24 * 60 * 60)
+
+// Heap kept for recently viewed rounds of per-race datasets. A round of
+// results is a few hundred bytes at most, so the default holds the last
+// several rounds of schedule, results and qualifying. Override at build time
+// to trade memory for refetches.
+#ifndef DATASET_CACHE_ROUND_BUDGET
+#define DATASET_CACHE_ROUND_BUDGET 2048
+#endif
+#define MAX_ROUND_ENTRIES 12
+
+#define DATASET_CACHE_FLAG_FINAL 0x01
+
+// Blob each dataset is persisted under. The ids rank the datasets for
+// eviction when storage runs short: the dictionary is needed to show any
+// cached id and the overview opens the app, while a single round is the
+// cheapest to fetch again.
+static const uint8_t s_blob_ids[DATASET_COUNT] = {
+    [DATASET_DICTIONARY] = 0,
+    [DATASET_OVERVIEW] = 1,
+    [DATASET_CALENDAR] = 2,
+    [DATASET_DRIVER_STANDINGS] = 3,
+    [DATASET_TEAM_STANDINGS] = 4,
+    [DATASET_RACE_DETAILS] = 5,
+    [DATASET_RACE_RESULTS] = 6,
+    [DATASET_QUALIFYING_RESULTS] = 7,
+};
+_Static_assert(DATASET_COUNT <= STORAGE_MAX_BLOBS,
+               "every dataset needs a blob id of its own");
+
+// Stored in front of the payload inside the same blob, so the metadata and
+// the payload it describes are always committed together.
+typedef struct {
+  uint32_t stored_at;
+  uint16_t season;
+  uint8_t round;
+  uint8_t flags;
+} DatasetCacheHeader;
+
+// A recent round of a per-race dataset held in memory, or a season-wide
+// dataset (round 0) that storage had no room for
+typedef struct {
+  uint8_t *data;
+  uint32_t stored_at;
+  uint16_t length;
+  uint8_t id;
+  uint8_t round;
+  // Received or confirmed by the phone this session
+  bool fresh;
+  bool final;
+  uint32_t hash;
+  uint32_t last_used;
+} RoundEntry;
+
+// What this session knows about each dataset's persisted blob. Storage may
+// evict the blob behind our back, so freshness also needs it to still exist.
+typedef struct {
+  // The blob was stored or read this session; the fields below describe it
+  bool known;
+  // Of the current season and recent enough to show
+  bool usable;
+  uint8_t round;
+  // Received or confirmed by the phone this session
+  bool fresh;
+  bool final;
+  // Of the payload, so the phone can be told it without reading the blob
+  uint32_t hash;
+} BlobState;
+
+static BlobState s_blobs[DATASET_COUNT];
+
+static RoundEntry s_rounds[MAX_ROUND_ENTRIES];
+static size_t s_round_bytes = 0;
+static uint32_t s_use_clock = 0;
+
+static RoundEntry *find_round(DatasetId id, int round) {
+  for (int i = 0; i < MAX_ROUND_ENTRIES; i++) {
+    RoundEntry *entry = &s_rounds[i];
+    if (entry->data && entry->id == id && entry->round == round) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+static void evict_round(RoundEntry *entry) {
+  s_round_bytes -= entry->length;
+  free(entry->data);
+  *entry = (RoundEntry){0};
+}
+
+// Hold a copy of a round's payload, evicting the least recently used rounds
+// until it fits the budget. Best effort: returns false if the payload could
+// not be held, and it is then read back from storage or refetched.
+static bool remember_round(DatasetId id, int round, const uint8_t *data,
+                           size_t length, uint32_t stored_at, bool fresh,
+                           bool final) {
+  if (round < 0 || round > UINT8_MAX || length > DATASET_CACHE_ROUND_BUDGET) {
+    return false;
+  }
+
+  RoundEntry *entry = find_round(id, round);
+  if (entry) {
+    evict_round(entry);
+  }
+
+  for (;;) {
+    RoundEntry *free_slot = NULL;
+    RoundEntry *oldest = NULL;
+    for (int i = 0; i < MAX_ROUND_ENTRIES; i++) {
+      RoundEntry *candidate = &s_rounds[i];
+      if (!candidate->data) {
+        free_slot = candidate;
+      } else if (!oldest || candidate->last_used < oldest->last_used) {
+        oldest = candidate;
+      }
+    }
+
+    if (free_slot && s_round_bytes + length <= DATASET_CACHE_ROUND_BUDGET) {
+      entry = free_slot;
+      break;
+    }
+    evict_round(oldest);
+  }
+
+  entry->data = malloc(length);
+  if (!entry->data) {
+    return false;
+  }
+  memcpy(entry->data, data, length);
+  entry->stored_at = stored_at;
+  entry->length = (uint16_t)length;
+  entry->id = (uint8_t)id;
+  entry->round = (uint8_t)round;
+  entry->fresh = fresh;
+  entry->final = final;
+  entry->hash = dataset_cache_payload_hash(data, length);
+  entry->last_used = ++s_use_clock;
+  s_round_bytes += length;
+  return true;
+}
+
+void dataset_cache_store(DatasetId id, int round, const uint8_t *data,
+                         size_t length, bool final) {
+  if (id >= DATASET_COUNT || !data) {
+    return;
+  }
+
+  size_t blob_length = sizeof(DatasetCacheHeader) + length;
+  uint8_t *blob = malloc(blob_length);
+  if (!blob) {
+    return;
+  }
+
+  DatasetCacheHeader header = {
+      .stored_at = (uint32_t)time(NULL),
+      .season = (uint16_t)g_current_season,
+      .round = (uint8_t)round,
+      .flags = final ? DATASET_CACHE_FLAG_FINAL : 0,
+  };
+  memcpy(blob, &header, sizeof(header));
+  memcpy(blob + sizeof(header), data, length);
+
+  // Whatever is held in memory for this round is replaced too
+  RoundEntry *entry = find_round(id, round);
+  if (entry) {
+    evict_round(entry);
+  }
+
+  bool persisted = storage_write_blob(s_blob_ids[id], blob, blob_length);
+  if (persisted) {
+    APP_LOG(APP_LOG_LEVEL_INFO, "Cached dataset %d (%d bytes)", (int)id,
+            (int)length);
+    s_blobs[id] = (BlobState){
+        .known = true,
+        .usable = true,
+        .round = header.round,
+        .fresh = true,
+        .final = final,
+        .hash = dataset_cache_payload_hash(data, length),
+    };
+  } else {
+    // The stored copy is now out of date; drop it so it is never read back
+    // as current
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Could not persist dataset %d (%d bytes)",
+            (int)id, (int)length);
+    storage_delete_blob(s_blob_ids[id]);
+    s_blobs[id] = (BlobState){0};
+  }
+  free(blob);
+
+  // Rounds are always kept in memory. A season-wide dataset only is when it
+  // could not be persisted, so it can still be read back, and is current,
+  // for as long as the LRU holds it.
+  if (round > 0 || !persisted) {
+    remember_round(id, round, data, length, header.stored_at, true, final);
+  }
+}
+
+// Read the persisted blob of a dataset if it is usable, recording what it
+// holds in s_blobs. Returns the payload, moved to the start of a heap buffer
+// the caller must free(), or NULL.
+static uint8_t *read_blob(DatasetId id, DatasetCacheHeader *header,
+                          size_t *length) {
+  BlobState *state = &s_blobs[id];
+  int blob_length = storage_blob_length(s_blob_ids[id]);
+  if (blob_length < (int)sizeof(DatasetCacheHeader)) {
+    *state = (BlobState){0};
+    return NULL;
+  }
+  if (state->known && !state->usable) {
+    return NULL;
+  }
+
+  uint8_t *blob = malloc(blob_length);
+  if (!blob) {
+    return NULL;
+  }
+
+  if (storage_read_blob(s_blob_ids[id], blob, blob_length) != blob_length) {
+    free(blob);
+    return NULL;
+  }
+
+  memcpy(header, blob, sizeof(*header));
+  *length = blob_length - sizeof(*header);
+  memmove(blob, blob + sizeof(*header), *length);
+
+  time_t now = time(NULL);
+  bool usable = header->season == g_current_season &&
+                now - (time_t)header->stored_at <= DATASET_CACHE_MAX_AGE;
+  if (!state->known) {
+    *state = (BlobState){
+        .known = true,
+        .usable = usable,
+        .round = header->round,
+        .final = header->flags & DATASET_CACHE_FLAG_FINAL,
+        .hash = dataset_cache_payload_hash(blob, *length),
+    };
+  }
+  if (!usable) {
+    free(blob);
+    return NULL;
+  }
+  return blob;
+}
+
+uint8_t *dataset_cache_read(DatasetId id, int round, size_t *length,
+                            time_t *stored_at) {
+  if (id >= DATASET_COUNT || !length) {
+    return NULL;
+  }
+
+  RoundEntry *entry = find_round(id, round);
+  if (entry) {
+    uint8_t *copy = malloc(entry->length);
+    if (copy) {
+      memcpy(copy, entry->data, entry->length);
+      *length = entry->length;
+      entry->last_used = ++s_use_clock;
+      if (stored_at) {
+        *stored_at = (time_t)entry->stored_at;
+      }
+    }
+    return copy;
+  }
+
+  DatasetCacheHeader header;
+  uint8_t *blob = read_blob(id, &header, length);
+  if (!blob) {
+    return NULL;
+  }
+  if (header.round != round) {
+    free(blob);
+    return NULL;
+  }
+
+  if (round > 0) {
+    remember_round(id, round, blob, *length, header.stored_at, false,
+                   header.flags & DATASET_CACHE_FLAG_FINAL);
+  }
+
+  if (stored_at) {
+    *stored_at = (time_t)header.stored_at;
+  }
+
+  return blob;
+}
+
+// Whether the persisted blob still holds this round and is current
+static bool blob_is_fresh(DatasetId id, int round) {
+  const BlobState *state = &s_blobs[id];
+  return state->known && state->usable && state->round == round &&
+         (state->fresh || state->final) &&
+         storage_blob_length(s_blob_ids[id]) >= (int)sizeof(DatasetCacheHeader);
+}
+
+bool dataset_cache_is_fresh(DatasetId id, int round) {
+  if (id >= DATASET_COUNT) {
+    return false;
+  }
+
+  RoundEntry *entry = find_round(id, round);
+  if (entry && (entry->fresh || entry->final)) {
+    return true;
+  }
+  return blob_is_fresh(id, round);
+}
+
+uint32_t dataset_cache_payload_hash(const uint8_t *data, size_t length) {
+  return storage_checksum(data, length);
+}
+
+bool dataset_cache_hash(DatasetId id, int round, uint32_t *hash) {
+  if (id >= DATASET_COUNT) {
+    return false;
+  }
+
+  // Looking a round up here must not count as using it, or sending requests
+  // would reorder the LRU
+  RoundEntry *entry = find_round(id, round);
+  if (entry) {
+    *hash = entry->hash;
+    return true;
+  }
+
+  // The blob is only read the first time this session
+  BlobState *state = &s_blobs[id];
+  if (!state->known) {
+    DatasetCacheHeader header;
+    size_t length = 0;
+    free(read_blob(id, &header, &length));
+  }
+  if (!state->known || !state->usable || state->round != round ||
+      storage_blob_length(s_blob_ids[id]) < (int)sizeof(DatasetCacheHeader)) {
+    return false;
+  }
+  *hash = state->hash;
+  return true;
+}
+
+void dataset_cache_mark_fresh(DatasetId id, int round) {
+  if (id >= DATASET_COUNT) {
+    return;
+  }
+  if (s_blobs[id].known && s_blobs[id].round == round) {
+    s_blobs[id].fresh = true;
+  }
+
+  RoundEntry *entry = find_round(id, round);
+  if (entry) {
+    entry->fresh = true;
+  }
+}
+
+void dataset_cache_forget(DatasetId id) {
+  if (id >= DATASET_COUNT) {
+    return;
+  }
+
+  storage_delete_blob(s_blob_ids[id]);
+  s_blobs[id] = (BlobState){0};
+  for (int i = 0; i < MAX_ROUND_ENTRIES; i++) {
+    RoundEntry *entry = &s_rounds[i];
+    if (entry->data && entry->id == id) {
+      evict_round(entry);
+    }
+  }
+}
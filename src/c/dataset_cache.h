@@ -0,0 +1,56 @@
+#pragma once
+
+#include <pebble.h>
+
+// Datasets the watch keeps a persisted copy of between launches
+typedef enum {
+  DATASET_OVERVIEW = 0,
+  DATASET_CALENDAR,
+  DATASET_RACE_DETAILS,
+  DATASET_DRIVER_STANDINGS,
+  DATASET_TEAM_STANDINGS,
+  DATASET_RACE_RESULTS,
+  DATASET_QUALIFYING_RESULTS,
+  DATASET_DICTIONARY,
+  DATASET_COUNT
+} DatasetId;
+
+// Store the latest payload received for a dataset.
+// round identifies per-race datasets and should be 0 for season-wide ones.
+// final marks a round's results as settled: they are then treated as fresh,
+// in this and later sessions, and never requested again.
+//
+// Only the latest payload of each dataset is persisted. Recent rounds of the
+// per-race datasets are also held in a small in-memory LRU, so flicking
+// between rounds does not refetch them. A payload storage has no room for is
+// kept in that LRU instead, and is still current for the session.
+void dataset_cache_store(DatasetId id, int round, const uint8_t *data,
+                         size_t length, bool final);
+
+// Read the cached payload for a dataset if it belongs to the current season
+// and the given round. Returns a heap copy the caller must free(), or NULL.
+// length receives the payload size; stored_at (optional) receives the time
+// the payload was cached.
+uint8_t *dataset_cache_read(DatasetId id, int round, size_t *length,
+                            time_t *stored_at);
+
+// True if the cached payload for this dataset and round was received from the
+// phone during this session, or is final, so there is no need to ask for it
+// again
+bool dataset_cache_is_fresh(DatasetId id, int round);
+
+// Content hash of a payload. The phone computes the same hash over the
+// payload it would send, so an unchanged dataset need not be sent again.
+uint32_t dataset_cache_payload_hash(const uint8_t *data, size_t length);
+
+// Hash of the cached payload for this dataset and round. Returns false if no
+// usable payload is cached. Hashes are kept from when each payload was stored
+// or first read, so this neither rereads storage nor reorders the LRU.
+bool dataset_cache_hash(DatasetId id, int round, uint32_t *hash);
+
+// Record that the phone confirmed the cached payload is still current
+void dataset_cache_mark_fresh(DatasetId id, int round);
+
+// Drop every cached copy of a dataset, persisted or in memory, e.g. when the
+// dictionary ids it refers to have been reassigned
+void dataset_cache_forget(DatasetId id);
@@ -0,0 +1,149 @@
+#include "dictionary.h"
+#include "data_models.h"
+#include "dataset_cache.h"
+#include "message_handler.h"
+#include "record_buffer.h"
+#include "utils.h"
+#include "wire_format.h"
+#include <pebble.h>
+
+// Ids are assigned densely from 0 by the phone, so they index the table, which
+// grows to the highest id received
+#define MAX_DICTIONARY_ENTRIES 64
+#define DICTIONARY_NAME_LENGTH 32
+
+typedef struct {
+  char name[DICTIONARY_NAME_LENGTH];
+  char short_name[SHORT_NAME_LENGTH];
+} DictionaryEntry;
+
+static DictionaryEntry *s_entries = NULL;
+static int s_entry_capacity = 0;
+// Ids below this have an entry; unnamed ones are zeroed
+static int s_entry_count = 0;
+
+// Dictionary a transfer from the phone is replacing, kept until the transfer
+// completes to tell whether any id now names someone else
+static DictionaryEntry *s_previous = NULL;
+static int s_previous_count = 0;
+static bool s_reassigned = false;
+
+// Make id a valid index, zeroing any entries added in front of it
+static bool reserve_entry(uint8_t id) {
+  if (id < s_entry_count) {
+    return true;
+  }
+  if (!record_buffer_reserve((void **)&s_entries, &s_entry_capacity, id + 1,
+                             sizeof(DictionaryEntry))) {
+    return false;
+  }
+  memset(&s_entries[s_entry_count], 0,
+         (id + 1 - s_entry_count) * sizeof(DictionaryEntry));
+  s_entry_count = id + 1;
+  return true;
+}
+
+// Dictionary record: id, full name
+static void read_entry_record(WireReader *reader, int index, void *context) {
+  uint8_t id = wire_read_u8(reader);
+  WireString name = wire_read_string(reader);
+  if (reader->error || id >= MAX_DICTIONARY_ENTRIES || !reserve_entry(id)) {
+    return;
+  }
+
+  DictionaryEntry *entry = &s_entries[id];
+  wire_string_copy(name, entry->name, sizeof(entry->name));
+  utils_format_driver_name(entry->name, entry->short_name, sizeof(entry->short_name));
+
+  if (id < s_previous_count && s_previous[id].name[0] &&
+      strcmp(s_previous[id].name, entry->name) != 0) {
+    s_reassigned = true;
+  }
+}
+
+static void free_previous(void) {
+  free(s_previous);
+  s_previous = NULL;
+  s_previous_count = 0;
+}
+
+// replace starts a new table; later chunks of a transfer add to it
+static void parse_dictionary_data(const uint8_t *data, size_t length,
+                                  bool replace) {
+  if (replace) {
+    free_previous();
+    s_previous = s_entries;
+    s_previous_count = s_entry_count;
+    s_entries = NULL;
+    s_entry_capacity = 0;
+    s_entry_count = 0;
+    s_reassigned = false;
+  }
+
+  // Entries land at their id, not their index, so the count is not needed
+  wire_parse_records(data, length, WIRE_SCHEMA_DICTIONARY, 0, UINT8_MAX,
+                     read_entry_record, NULL);
+}
+
+static void load_cached_data(void) {
+  size_t length = 0;
+  uint8_t *cached = dataset_cache_read(DATASET_DICTIONARY, 0, &length, NULL);
+  if (cached) {
+    parse_dictionary_data(cached, length, true);
+    free_previous();
+    free(cached);
+  }
+}
+
+static void dictionary_payload_received(const MessagePayload *payload, void *context) {
+  parse_dictionary_data(payload->data, payload->length,
+                        payload->chunk_index == 0);
+  if (!message_payload_is_complete(payload)) {
+    return;
+  }
+  // Ids only go away when the phone starts again from 0
+  if (s_entry_count < s_previous_count) {
+    s_reassigned = true;
+  }
+  free_previous();
+
+  // The phone starts the season's ids again when it runs out of them, so
+  // anything cached under the old ids would show the wrong names. A renamed
+  // driver or constructor looks the same and costs a refetch too.
+  if (s_reassigned) {
+    APP_LOG(APP_LOG_LEVEL_INFO, "Dictionary ids reassigned");
+    dataset_cache_forget(DATASET_DRIVER_STANDINGS);
+    dataset_cache_forget(DATASET_TEAM_STANDINGS);
+    dataset_cache_forget(DATASET_RACE_RESULTS);
+    dataset_cache_forget(DATASET_QUALIFYING_RESULTS);
+    s_reassigned = false;
+  }
+}
+
+void dictionary_init(void) {
+  load_cached_data();
+  message_handler_subscribe(REQUEST_TYPE_GET_DICTIONARY,
+                            dictionary_payload_received, NULL);
+}
+
+void dictionary_deinit(void) {
+  message_handler_unsubscribe(REQUEST_TYPE_GET_DICTIONARY,
+                              dictionary_payload_received);
+  record_buffer_free((void **)&s_entries, &s_entry_capacity);
+  s_entry_count = 0;
+  free_previous();
+}
+
+const char *dictionary_name(uint8_t id) {
+  if (id >= s_entry_count || !s_entries[id].name[0]) {
+    return "?";
+  }
+  return s_entries[id].name;
+}
+
+const char *dictionary_short_name(uint8_t id) {
+  if (id >= s_entry_count || !s_entries[id].short_name[0]) {
+    return "?";
+  }
+  return s_entries[id].short_name;
+}
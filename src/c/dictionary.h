@@ -0,0 +1,18 @@
+#pragma once
+
+#include <pebble.h>
+
+// Session-wide names of the season's drivers and constructors. Standings and
+// results refer to them by the small id the phone assigned, so each name is
+// sent and held once however many screens show it.
+
+// Load the cached dictionary and start listening for updates from the phone
+void dictionary_init(void);
+
+void dictionary_deinit(void);
+
+// Full name for an id, e.g. "Max Verstappen" or "McLaren". Never NULL.
+const char *dictionary_name(uint8_t id);
+
+// Abbreviated driver name for narrow rows, e.g. "M.Verstappen". Never NULL.
+const char *dictionary_short_name(uint8_t id);
@@ -1,5 +1,7 @@
 #include "data_models.h"
+#include "dictionary.h"
 #include "message_handler.h"
+#include "prefetch.h"
 #include "windows/dashboard_window.h"
 #include <pebble.h>
 
@@ -16,9 +18,11 @@ static void init(void) {
 
   // Initialize message handler
   message_handler_init();
+  dictionary_init();
 
-  // Prefetch dashboard overview as early as possible
-  message_handler_request_overview();
+  // Prefetch everything the dashboard links to as early as possible, so its
+  // screens open without waiting on the phone
+  message_handler_request_bootstrap();
 
   // Push dashboard window
   dashboard_window_push();
@@ -29,6 +33,8 @@ static void deinit(void) {
   dashboard_window_destroy();
 
   // Cleanup message handler
+  prefetch_cancel();
+  dictionary_deinit();
   message_handler_deinit();
 
   APP_LOG(APP_LOG_LEVEL_INFO, "F1 Flashback deinitialized");
@@ -1,187 +1,807 @@
 #include "message_handler.h"
+#include "dataset_cache.h"
+#include "wire_format.h"
 #include <pebble.h>
 
-// Callback storage
-static OverviewDataCallback s_overview_data_callback = NULL;
-static OverviewCompleteCallback s_overview_complete_callback = NULL;
-static RaceDetailsDataCallback s_race_details_data_callback = NULL;
-static RaceDetailsCompleteCallback s_race_details_complete_callback = NULL;
-static DriverStandingsDataCallback s_driver_standings_data_callback = NULL;
-static DriverStandingsCompleteCallback s_driver_standings_complete_callback = NULL;
-static TeamStandingsDataCallback s_team_standings_data_callback = NULL;
-static TeamStandingsCompleteCallback s_team_standings_complete_callback = NULL;
-static OverviewMessageCallback s_overview_message_callback = NULL;
-
-static char s_cached_overview_text[128] = "";
-static bool s_cached_overview_present = false;
-
-// Message received handler
-static void inbox_received_callback(DictionaryIterator *iterator,
-                                    void *context) {
-  Tuple *overview_tuple = dict_find(iterator, MESSAGE_KEY_OVERVIEW);
-  if (overview_tuple) {
-    const char *overview_text = overview_tuple->value->cstring;
-    APP_LOG(APP_LOG_LEVEL_INFO, "Received overview message (%d chars)",
-            (int)strlen(overview_text));
-
-    // Cache the dashboard overview text so callbacks registered later can still
-    // receive the data if the overview request was sent before the window loaded.
-    strncpy(s_cached_overview_text, overview_text,
-            sizeof(s_cached_overview_text) - 1);
-    s_cached_overview_text[sizeof(s_cached_overview_text) - 1] = '\0';
-    s_cached_overview_present = true;
-
-    if (s_overview_message_callback) {
-      s_overview_message_callback(s_cached_overview_text);
+#define MAX_SUBSCRIPTIONS 10
+
+// Outgoing requests are sent one at a time; the next one goes out only after
+// the phone has acknowledged the previous one
+#define REQUEST_QUEUE_SIZE 8
+#define REQUEST_NO_INDEX -1
+#define RETRY_BASE_DELAY_MS 250
+#define RETRY_MAX_DELAY_MS 8000
+#define RETRY_MAX_ATTEMPTS 8
+
+// A sent request stops absorbing duplicates if no reply arrives within this
+#define REPLY_TIMEOUT_S 15
+
+typedef struct {
+  RequestType type;
+  MessageHandlerCallback callback;
+  void *context;
+} Subscription;
+
+static Subscription s_subscriptions[MAX_SUBSCRIPTIONS];
+
+// Chunks of the transfer in progress, joined back into one payload so the
+// whole dataset can be cached once the last chunk arrives
+typedef struct {
+  int transfer_id;
+  // Request the transfer answers, 0 if the phone did not say
+  uint16_t request_id;
+  int next_chunk;
+  int record_count;
+  uint8_t *data;
+  size_t length;
+} Reassembly;
+
+static Reassembly s_reassembly = {.transfer_id = -1};
+
+// The replies a bootstrap request is answered with
+static const RequestType s_bootstrap_parts[] = {
+    REQUEST_TYPE_GET_OVERVIEW,
+    REQUEST_TYPE_GET_CALENDAR,
+    REQUEST_TYPE_GET_DRIVER_STANDINGS,
+    REQUEST_TYPE_GET_TEAM_STANDINGS,
+};
+
+// The replies a race weekend request is answered with, all for its round
+static const RequestType s_race_weekend_parts[] = {
+    REQUEST_TYPE_GET_RACE_DETAILS,
+    REQUEST_TYPE_GET_RACE_RESULTS,
+    REQUEST_TYPE_GET_QUALIFYING_RESULTS,
+};
+
+#define MAX_REQUEST_PARTS ARRAY_LENGTH(s_bootstrap_parts)
+_Static_assert(ARRAY_LENGTH(s_race_weekend_parts) <= MAX_REQUEST_PARTS,
+               "race weekend has more parts than the hash list holds");
+
+// Requests answered with several replies list them in parts and return how
+// many there are; a request answered with its own reply returns 0
+static size_t request_parts(RequestType type, const RequestType **parts) {
+  switch (type) {
+  case REQUEST_TYPE_GET_BOOTSTRAP:
+    *parts = s_bootstrap_parts;
+    return ARRAY_LENGTH(s_bootstrap_parts);
+  case REQUEST_TYPE_GET_RACE_WEEKEND:
+    *parts = s_race_weekend_parts;
+    return ARRAY_LENGTH(s_race_weekend_parts);
+  default:
+    *parts = NULL;
+    return 0;
+  }
+}
+
+// Every request carries an id the phone echoes on each message of its reply,
+// so replies to a request cancelled since can be told apart and dropped
+typedef struct {
+  RequestType type;
+  int index;
+  uint16_t id;
+  time_t sent_at;
+} QueuedRequest;
+
+static QueuedRequest s_request_queue[REQUEST_QUEUE_SIZE];
+static int s_queue_head = 0;
+static int s_queue_count = 0;
+static bool s_request_in_flight = false;
+static int s_retry_attempts = 0;
+static AppTimer *s_retry_timer = NULL;
+
+// Requests the phone has accepted but not yet answered; sent_at 0 is a free slot
+static QueuedRequest s_awaiting_reply[REQUEST_QUEUE_SIZE];
+
+// Ids of the most recently cancelled requests, oldest overwritten first
+static uint16_t s_cancelled_ids[REQUEST_QUEUE_SIZE];
+static int s_next_cancelled = 0;
+// 0 is never used, so a reply without an id never matches
+static uint16_t s_next_request_id = 1;
+
+static uint16_t next_request_id(void) {
+  uint16_t id = s_next_request_id++;
+  if (s_next_request_id == 0) {
+    s_next_request_id = 1;
+  }
+  return id;
+}
+
+static bool is_cancelled(uint16_t id) {
+  if (id == 0) {
+    return false;
+  }
+  for (int i = 0; i < REQUEST_QUEUE_SIZE; i++) {
+    if (s_cancelled_ids[i] == id) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool request_matches(const QueuedRequest *request, RequestType type,
+                            int index) {
+  return request->type == type && request->index == index;
+}
+
+// True if a queued request will be answered with this type's reply
+static bool request_covers(const QueuedRequest *request, RequestType type,
+                           int index) {
+  if (request_matches(request, type, index)) {
+    return true;
+  }
+
+  // Every part of a multi-part request is for the request's own round
+  const RequestType *parts;
+  size_t part_count = request_parts(request->type, &parts);
+  if (index == request->index) {
+    for (size_t i = 0; i < part_count; i++) {
+      if (parts[i] == type) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static bool is_awaiting_reply(const QueuedRequest *request, time_t now) {
+  return request->sent_at != 0 && now - request->sent_at < REPLY_TIMEOUT_S;
+}
+
+// Remember a sent request until its reply arrives, reusing its old slot or
+// the oldest one if the table is full
+static void track_awaiting_reply(const QueuedRequest *request) {
+  time_t now = time(NULL);
+  QueuedRequest *slot = &s_awaiting_reply[0];
+
+  for (int i = 0; i < REQUEST_QUEUE_SIZE; i++) {
+    QueuedRequest *candidate = &s_awaiting_reply[i];
+    if (request_matches(candidate, request->type, request->index) ||
+        !is_awaiting_reply(candidate, now)) {
+      slot = candidate;
+      break;
+    }
+    if (candidate->sent_at < slot->sent_at) {
+      slot = candidate;
+    }
+  }
+
+  *slot = *request;
+  slot->sent_at = now;
+}
+
+static void clear_awaiting_reply(RequestType type, int round) {
+  for (int i = 0; i < REQUEST_QUEUE_SIZE; i++) {
+    QueuedRequest *request = &s_awaiting_reply[i];
+    if (request->type == type &&
+        (request->index == REQUEST_NO_INDEX || request->index == round)) {
+      request->sent_at = 0;
+    }
+  }
+}
+
+// True if an identical request is queued, being sent, or waiting on its reply
+static bool is_request_pending(RequestType type, int index) {
+  for (int i = 0; i < s_queue_count; i++) {
+    int slot = (s_queue_head + i) % REQUEST_QUEUE_SIZE;
+    if (request_covers(&s_request_queue[slot], type, index)) {
+      return true;
+    }
+  }
+
+  time_t now = time(NULL);
+  for (int i = 0; i < REQUEST_QUEUE_SIZE; i++) {
+    QueuedRequest *request = &s_awaiting_reply[i];
+    if (request_covers(request, type, index) && is_awaiting_reply(request, now)) {
+      return true;
+    }
+  }
+
+  // A multi-part request is covered once each of its parts is on its way
+  const RequestType *parts;
+  size_t part_count = request_parts(type, &parts);
+  for (size_t i = 0; i < part_count; i++) {
+    if (!is_request_pending(parts[i], index)) {
+      return false;
+    }
+  }
+  return part_count > 0;
+}
+
+// Map a payload's schema id to the dataset it should be cached as
+static bool dataset_for_schema(uint8_t schema, DatasetId *dataset) {
+  switch (schema) {
+  case WIRE_SCHEMA_OVERVIEW:
+    *dataset = DATASET_OVERVIEW;
+    return true;
+  case WIRE_SCHEMA_CALENDAR:
+    *dataset = DATASET_CALENDAR;
+    return true;
+  case WIRE_SCHEMA_RACE_SCHEDULE:
+    *dataset = DATASET_RACE_DETAILS;
+    return true;
+  case WIRE_SCHEMA_DRIVER_STANDINGS:
+    *dataset = DATASET_DRIVER_STANDINGS;
+    return true;
+  case WIRE_SCHEMA_TEAM_STANDINGS:
+    *dataset = DATASET_TEAM_STANDINGS;
+    return true;
+  case WIRE_SCHEMA_RACE_RESULTS:
+    *dataset = DATASET_RACE_RESULTS;
+    return true;
+  case WIRE_SCHEMA_QUALIFYING_RESULTS:
+    *dataset = DATASET_QUALIFYING_RESULTS;
+    return true;
+  case WIRE_SCHEMA_DICTIONARY:
+    *dataset = DATASET_DICTIONARY;
+    return true;
+  default:
+    return false;
+  }
+}
+
+static bool dataset_for_request(RequestType type, DatasetId *dataset) {
+  switch (type) {
+  case REQUEST_TYPE_GET_OVERVIEW:
+    *dataset = DATASET_OVERVIEW;
+    return true;
+  case REQUEST_TYPE_GET_CALENDAR:
+    *dataset = DATASET_CALENDAR;
+    return true;
+  case REQUEST_TYPE_GET_RACE_DETAILS:
+    *dataset = DATASET_RACE_DETAILS;
+    return true;
+  case REQUEST_TYPE_GET_DRIVER_STANDINGS:
+    *dataset = DATASET_DRIVER_STANDINGS;
+    return true;
+  case REQUEST_TYPE_GET_TEAM_STANDINGS:
+    *dataset = DATASET_TEAM_STANDINGS;
+    return true;
+  case REQUEST_TYPE_GET_RACE_RESULTS:
+    *dataset = DATASET_RACE_RESULTS;
+    return true;
+  case REQUEST_TYPE_GET_QUALIFYING_RESULTS:
+    *dataset = DATASET_QUALIFYING_RESULTS;
+    return true;
+  case REQUEST_TYPE_GET_DICTIONARY:
+    *dataset = DATASET_DICTIONARY;
+    return true;
+  default:
+    return false;
+  }
+}
+
+static void reassembly_reset(void) {
+  free(s_reassembly.data);
+  s_reassembly = (Reassembly){.transfer_id = -1};
+}
+
+// Add a chunk to the transfer being reassembled. Returns false if the chunk
+// does not continue the transfer, which is then abandoned.
+static bool reassembly_add(int transfer_id, uint16_t request_id,
+                           const MessagePayload *chunk) {
+  if (chunk->chunk_index == 0) {
+    reassembly_reset();
+    s_reassembly.transfer_id = transfer_id;
+    s_reassembly.request_id = request_id;
+  } else if (transfer_id != s_reassembly.transfer_id ||
+             chunk->chunk_index != s_reassembly.next_chunk) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Chunk %d of transfer %d out of order",
+            chunk->chunk_index, transfer_id);
+    reassembly_reset();
+    return false;
+  }
+
+  // Chunks share the schema byte; only the first keeps its header
+  size_t skip = chunk->chunk_index == 0 ? 0 : WIRE_HEADER_SIZE;
+  size_t added = chunk->length - skip;
+  uint8_t *data = realloc(s_reassembly.data, s_reassembly.length + added);
+  if (!data) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "No memory to reassemble transfer %d",
+            transfer_id);
+    reassembly_reset();
+    return false;
+  }
+
+  memcpy(data + s_reassembly.length, chunk->data + skip, added);
+  s_reassembly.data = data;
+  s_reassembly.length += added;
+  s_reassembly.record_count += chunk->data[1];
+  s_reassembly.next_chunk++;
+  return true;
+}
+
+static void cache_payload(const MessagePayload *payload, const uint8_t *data,
+                          size_t length) {
+  DatasetId dataset;
+  if (dataset_for_schema(data[0], &dataset)) {
+    dataset_cache_store(dataset, payload->round, data, length, payload->final);
+  } else {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Unknown payload schema: %d", (int)data[0]);
+  }
+}
+
+static void dispatch_payload(const MessagePayload *payload) {
+  for (int i = 0; i < MAX_SUBSCRIPTIONS; i++) {
+    Subscription *subscription = &s_subscriptions[i];
+    if (subscription->callback && subscription->type == payload->type) {
+      subscription->callback(payload, subscription->context);
     }
+  }
+}
+
+static void write_hash(uint8_t *out, uint32_t hash) {
+  for (int i = 0; i < 4; i++) {
+    out[i] = (uint8_t)(hash >> (8 * i));
+  }
+}
+
+static uint32_t read_hash(const uint8_t *in) {
+  return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) |
+         ((uint32_t)in[3] << 24);
+}
+
+// The phone found our cached copy current and sent its hash instead of the
+// payload. Deliver the cached copy to subscribers as if it had just arrived.
+static void deliver_not_modified(RequestType type, int round, uint32_t hash,
+                                 bool final) {
+  clear_awaiting_reply(type, round);
+
+  DatasetId dataset;
+  if (!dataset_for_request(type, &dataset)) {
+    return;
+  }
+
+  size_t length = 0;
+  uint8_t *data = dataset_cache_read(dataset, round, &length, NULL);
+  if (!data) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Request %d not modified but not cached",
+            (int)type);
+    return;
+  }
+
+  if (dataset_cache_payload_hash(data, length) != hash) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Request %d not modified but cache changed",
+            (int)type);
+    free(data);
     return;
   }
 
-  // Read request type
+  APP_LOG(APP_LOG_LEVEL_INFO, "Request %d not modified", (int)type);
+
+  MessagePayload payload = {
+      .type = type,
+      .round = round,
+      .data = data,
+      .length = length,
+      .chunk_index = 0,
+      .chunk_count = 1,
+      .final = final,
+  };
+
+  // Storing it again records that it became final; otherwise the copy we
+  // hold only needs marking as current
+  if (final) {
+    cache_payload(&payload, data, length);
+  } else {
+    dataset_cache_mark_fresh(dataset, round);
+  }
+  dispatch_payload(&payload);
+  free(data);
+}
+
+// The phone sent only what changed since the copy we hold. Rebuild the whole
+// payload from the cached copy, then cache and deliver it like a full one.
+static void deliver_patch(RequestType type, int round, uint32_t base_hash,
+                          const uint8_t *patch, size_t patch_length,
+                          bool final) {
+  clear_awaiting_reply(type, round);
+
+  DatasetId dataset;
+  if (!dataset_for_request(type, &dataset)) {
+    return;
+  }
+
+  size_t base_length = 0;
+  uint8_t *base = dataset_cache_read(dataset, round, &base_length, NULL);
+  if (!base || dataset_cache_payload_hash(base, base_length) != base_hash) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Patch for request %d does not match cache",
+            (int)type);
+    free(base);
+    return;
+  }
+
+  size_t length = 0;
+  uint8_t *data = wire_apply_patch(base, base_length, patch, patch_length, &length);
+  free(base);
+  if (!data) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to apply patch for request %d",
+            (int)type);
+    return;
+  }
+
+  APP_LOG(APP_LOG_LEVEL_INFO, "Patched request %d (%d bytes to %d bytes)",
+          (int)type, (int)patch_length, (int)length);
+
+  MessagePayload payload = {
+      .type = type,
+      .round = round,
+      .data = data,
+      .length = length,
+      .chunk_index = 0,
+      .chunk_count = 1,
+      .final = final,
+  };
+  cache_payload(&payload, data, length);
+  dispatch_payload(&payload);
+  free(data);
+}
+
+// Single inbox for the whole app: persist the payload, then route it to
+// every window subscribed to its request type
+static void inbox_received_callback(DictionaryIterator *iterator,
+                                    void *context) {
   Tuple *request_type_tuple = dict_find(iterator, MESSAGE_KEY_REQUEST_TYPE);
   if (!request_type_tuple) {
     APP_LOG(APP_LOG_LEVEL_ERROR, "No request type in message");
     return;
   }
 
-  int request_type = request_type_tuple->value->int32;
+  // A reply to a request cancelled since is of no use to anyone; drop it
+  // before it is reassembled, cached or parsed
+  Tuple *request_id_tuple = dict_find(iterator, MESSAGE_KEY_REQUEST_ID);
+  uint16_t request_id = request_id_tuple ? (uint16_t)request_id_tuple->value->int32 : 0;
+  if (is_cancelled(request_id)) {
+    APP_LOG(APP_LOG_LEVEL_INFO, "Dropping reply to cancelled request %d",
+            (int)request_id);
+    return;
+  }
 
-  // Read other fields
-  Tuple *index_tuple = dict_find(iterator, MESSAGE_KEY_DATA_INDEX);
+  Tuple *round_tuple = dict_find(iterator, MESSAGE_KEY_DATA_ROUND);
+  Tuple *payload_tuple = dict_find(iterator, MESSAGE_KEY_DATA_PAYLOAD);
+  Tuple *hash_tuple = dict_find(iterator, MESSAGE_KEY_DATA_HASH);
+  Tuple *patch_tuple = dict_find(iterator, MESSAGE_KEY_DATA_PATCH);
+  Tuple *final_tuple = dict_find(iterator, MESSAGE_KEY_DATA_FINAL);
+  bool final = final_tuple && final_tuple->value->int32 != 0;
+  if (!payload_tuple && hash_tuple && hash_tuple->length == sizeof(uint32_t)) {
+    RequestType type = (RequestType)request_type_tuple->value->int32;
+    int round = round_tuple ? (int)round_tuple->value->int32 : 0;
+    uint32_t hash = read_hash(hash_tuple->value->data);
+    if (patch_tuple) {
+      deliver_patch(type, round, hash, patch_tuple->value->data,
+                    patch_tuple->length, final);
+    } else {
+      deliver_not_modified(type, round, hash, final);
+    }
+    return;
+  }
+
+  if (!payload_tuple || payload_tuple->length < WIRE_HEADER_SIZE) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "No payload in message");
+    return;
+  }
+
+  Tuple *transfer_tuple = dict_find(iterator, MESSAGE_KEY_DATA_TRANSFER);
+  Tuple *chunk_tuple = dict_find(iterator, MESSAGE_KEY_DATA_CHUNK);
   Tuple *count_tuple = dict_find(iterator, MESSAGE_KEY_DATA_COUNT);
-  Tuple *title_tuple = dict_find(iterator, MESSAGE_KEY_DATA_TITLE);
-  Tuple *subtitle_tuple = dict_find(iterator, MESSAGE_KEY_DATA_SUBTITLE);
-  Tuple *extra_tuple = dict_find(iterator, MESSAGE_KEY_DATA_EXTRA);
+  MessagePayload payload = {
+      .type = (RequestType)request_type_tuple->value->int32,
+      .round = round_tuple ? (int)round_tuple->value->int32 : 0,
+      .data = payload_tuple->value->data,
+      .length = payload_tuple->length,
+      .chunk_index = chunk_tuple ? (int)chunk_tuple->value->int32 : 0,
+      .chunk_count = count_tuple ? (int)count_tuple->value->int32 : 1,
+      .final = final,
+  };
+
+  APP_LOG(APP_LOG_LEVEL_INFO, "Received chunk %d/%d for request %d (%d bytes)",
+          payload.chunk_index + 1, payload.chunk_count, (int)payload.type,
+          (int)payload.length);
+
+  if (payload.chunk_count <= 1) {
+    cache_payload(&payload, payload.data, payload.length);
+  } else {
+    int transfer_id = transfer_tuple ? (int)transfer_tuple->value->int32 : 0;
+    // Windows append chunks in order, so a chunk that breaks the sequence is
+    // dropped along with the rest of its transfer
+    if (!reassembly_add(transfer_id, request_id, &payload)) {
+      return;
+    }
 
-  switch (request_type) {
-  case REQUEST_TYPE_GET_OVERVIEW:
-    if (count_tuple) {
-      // This is the count message
-      int count = count_tuple->value->int32;
-      APP_LOG(APP_LOG_LEVEL_INFO, "Received overview count: %d", count);
-      if (s_overview_complete_callback) {
-        s_overview_complete_callback(count);
-      }
-    } else if (index_tuple && title_tuple && subtitle_tuple) {
-      // This is a data message
-      int index = index_tuple->value->int32;
-      const char *title = title_tuple->value->cstring;
-      const char *subtitle = subtitle_tuple->value->cstring;
-      const char *extra = extra_tuple ? extra_tuple->value->cstring : "";
+    // The joined record count must still fit the one-byte header field
+    if (message_payload_is_complete(&payload) &&
+        s_reassembly.record_count <= UINT8_MAX) {
+      s_reassembly.data[1] = (uint8_t)s_reassembly.record_count;
+      cache_payload(&payload, s_reassembly.data, s_reassembly.length);
+    }
+  }
 
-      // Read round number
-      Tuple *round_tuple = dict_find(iterator, MESSAGE_KEY_DATA_ROUND);
-      int round = round_tuple ? round_tuple->value->int32 : 0;
+  if (message_payload_is_complete(&payload)) {
+    clear_awaiting_reply(payload.type, payload.round);
+    reassembly_reset();
+  }
 
-      APP_LOG(APP_LOG_LEVEL_INFO, "Received race %d: %s (round %d)", index, title, round);
+  dispatch_payload(&payload);
+}
 
-      if (s_overview_data_callback) {
-        s_overview_data_callback(index, title, subtitle, extra, round);
-      }
-    }
-    break;
+// Message dropped handler
+static void inbox_dropped_callback(AppMessageResult reason, void *context) {
+  APP_LOG(APP_LOG_LEVEL_ERROR, "Message dropped: %d", (int)reason);
+}
 
-  case REQUEST_TYPE_GET_RACE_DETAILS:
-    if (count_tuple) {
-      // This is the count message
-      int count = count_tuple->value->int32;
-      APP_LOG(APP_LOG_LEVEL_INFO, "Received race details count: %d", count);
-      if (s_race_details_complete_callback) {
-        s_race_details_complete_callback(count);
-      }
-    } else if (index_tuple && title_tuple && subtitle_tuple) {
-      // This is a data message
-      int index = index_tuple->value->int32;
-      const char *title = title_tuple->value->cstring;
-      const char *subtitle = subtitle_tuple->value->cstring;
-      const char *extra = extra_tuple ? extra_tuple->value->cstring : "";
+static void send_next_request(void);
 
-      APP_LOG(APP_LOG_LEVEL_INFO, "Received event %d: %s", index, title);
+static void retry_timer_callback(void *context) {
+  s_retry_timer = NULL;
+  send_next_request();
+}
 
-      if (s_race_details_data_callback) {
-        s_race_details_data_callback(index, title, subtitle, extra);
-      }
+static void pop_request(void) {
+  s_queue_head = (s_queue_head + 1) % REQUEST_QUEUE_SIZE;
+  s_queue_count--;
+  s_retry_attempts = 0;
+}
+
+// Try the request at the head of the queue again later, doubling the delay
+// each time up to RETRY_MAX_DELAY_MS
+static void schedule_retry(void) {
+  if (s_retry_timer || s_queue_count == 0) {
+    return;
+  }
+
+  s_retry_attempts++;
+  if (s_retry_attempts > RETRY_MAX_ATTEMPTS) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Giving up on request %d after %d attempts",
+            (int)s_request_queue[s_queue_head].type, RETRY_MAX_ATTEMPTS);
+    pop_request();
+  }
+
+  uint32_t delay = RETRY_BASE_DELAY_MS;
+  for (int i = 1; i < s_retry_attempts && delay < RETRY_MAX_DELAY_MS; i++) {
+    delay *= 2;
+  }
+  if (delay > RETRY_MAX_DELAY_MS) {
+    delay = RETRY_MAX_DELAY_MS;
+  }
+
+  s_retry_timer = app_timer_register(delay, retry_timer_callback, NULL);
+}
+
+// Write the hash of each cached dataset the request would replace, so the
+// phone can answer "not modified" instead of resending it. A multi-part
+// request lists its parts in order, e.g. s_bootstrap_parts. The dictionary's
+// hash always comes last, so the phone knows whether to send it first. 0
+// means not cached.
+static void write_cached_hashes(DictionaryIterator *iter,
+                                const QueuedRequest *request) {
+  uint8_t hashes[(MAX_REQUEST_PARTS + 1) * sizeof(uint32_t)];
+  size_t length = 0;
+  uint32_t hash;
+  int round = request->index == REQUEST_NO_INDEX ? 0 : request->index;
+
+  const RequestType *parts;
+  size_t part_count = request_parts(request->type, &parts);
+  if (part_count == 0) {
+    parts = &request->type;
+    part_count = 1;
+  }
+
+  for (size_t i = 0; i < part_count; i++) {
+    DatasetId dataset;
+    hash = 0;
+    if (dataset_for_request(parts[i], &dataset)) {
+      dataset_cache_hash(dataset, round, &hash);
     }
-    break;
+    write_hash(&hashes[length], hash);
+    length += sizeof(uint32_t);
+  }
 
-  case REQUEST_TYPE_GET_DRIVER_STANDINGS:
-    if (count_tuple) {
-      // This is the count message
-      int count = count_tuple->value->int32;
-      APP_LOG(APP_LOG_LEVEL_INFO, "Received driver standings count: %d", count);
-      if (s_driver_standings_complete_callback) {
-        s_driver_standings_complete_callback(count);
-      }
-    } else if (index_tuple && title_tuple && subtitle_tuple) {
-      // This is a data message
-      int index = index_tuple->value->int32;
-      const char *name = title_tuple->value->cstring;
-      const char *code = subtitle_tuple->value->cstring;
-
-      // Read points and position
-      Tuple *points_tuple = dict_find(iterator, MESSAGE_KEY_DATA_POINTS);
-      Tuple *position_tuple = dict_find(iterator, MESSAGE_KEY_DATA_POSITION);
-      int points = points_tuple ? points_tuple->value->int32 : 0;
-      int position = position_tuple ? position_tuple->value->int32 : 0;
-
-      APP_LOG(APP_LOG_LEVEL_INFO, "Received driver %d: %s (%s) - %d pts, P%d",
-              index, name, code, points, position);
-
-      if (s_driver_standings_data_callback) {
-        s_driver_standings_data_callback(index, name, code, points, position);
-      }
+  hash = 0;
+  dataset_cache_hash(DATASET_DICTIONARY, 0, &hash);
+  write_hash(&hashes[length], hash);
+  length += sizeof(uint32_t);
+
+  dict_write_data(iter, MESSAGE_KEY_DATA_HASH, hashes, length);
+}
+
+static void send_next_request(void) {
+  if (s_request_in_flight || s_retry_timer || s_queue_count == 0) {
+    return;
+  }
+
+  // Nothing can be delivered while the phone is away; the connection handler
+  // restarts the queue when it comes back
+  if (!connection_service_peek_pebble_app_connection()) {
+    return;
+  }
+
+  // A request cancelled while it was being sent is not tried again
+  QueuedRequest *request = &s_request_queue[s_queue_head];
+  if (is_cancelled(request->id)) {
+    pop_request();
+    send_next_request();
+    return;
+  }
+
+  DictionaryIterator *iter;
+  AppMessageResult result = app_message_outbox_begin(&iter);
+  if (result != APP_MSG_OK) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Failed to begin request %d: %d",
+            (int)request->type, (int)result);
+    schedule_retry();
+    return;
+  }
+
+  dict_write_uint8(iter, MESSAGE_KEY_REQUEST_TYPE, request->type);
+  dict_write_uint16(iter, MESSAGE_KEY_REQUEST_ID, request->id);
+  if (request->index != REQUEST_NO_INDEX) {
+    dict_write_int32(iter, MESSAGE_KEY_DATA_INDEX, request->index);
+  }
+  if (request->type != REQUEST_TYPE_CANCEL) {
+    write_cached_hashes(iter, request);
+  }
+
+  result = app_message_outbox_send();
+  if (result != APP_MSG_OK) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Failed to send request %d: %d",
+            (int)request->type, (int)result);
+    schedule_retry();
+    return;
+  }
+
+  s_request_in_flight = true;
+  APP_LOG(APP_LOG_LEVEL_INFO, "Sent request %d (index %d)", (int)request->type,
+          request->index);
+}
+
+static bool push_request(const QueuedRequest *request) {
+  if (s_queue_count == REQUEST_QUEUE_SIZE) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Request queue full, dropping request %d",
+            (int)request->type);
+    return false;
+  }
+
+  int tail = (s_queue_head + s_queue_count) % REQUEST_QUEUE_SIZE;
+  s_request_queue[tail] = *request;
+  s_queue_count++;
+  return true;
+}
+
+// A request replaces an older one for another round of data it also covers,
+// e.g. race results of round 6 replace those of round 5: the user has moved
+// on, so the older reply would only be ignored on arrival
+static bool supersedes(const QueuedRequest *request, const QueuedRequest *older) {
+  return request->index != REQUEST_NO_INDEX &&
+         older->index != REQUEST_NO_INDEX && older->index != request->index &&
+         request_covers(request, older->type, request->index);
+}
+
+// Forget a request the phone has or is about to have, and tell it to stop
+// work on the reply. Replies already on their way are dropped by id.
+static void cancel_request(uint16_t id) {
+  if (is_cancelled(id)) {
+    return;
+  }
+
+  APP_LOG(APP_LOG_LEVEL_INFO, "Cancelling request id %d", (int)id);
+  s_cancelled_ids[s_next_cancelled] = id;
+  s_next_cancelled = (s_next_cancelled + 1) % REQUEST_QUEUE_SIZE;
+
+  for (int i = 0; i < REQUEST_QUEUE_SIZE; i++) {
+    if (s_awaiting_reply[i].id == id) {
+      s_awaiting_reply[i].sent_at = 0;
     }
-    break;
+  }
+  if (s_reassembly.request_id == id) {
+    reassembly_reset();
+  }
 
-  case REQUEST_TYPE_GET_TEAM_STANDINGS:
-    if (count_tuple) {
-      // This is the count message
-      int count = count_tuple->value->int32;
-      APP_LOG(APP_LOG_LEVEL_INFO, "Received team standings count: %d", count);
-      if (s_team_standings_complete_callback) {
-        s_team_standings_complete_callback(count);
-      }
-    } else if (index_tuple && title_tuple) {
-      // This is a data message
-      int index = index_tuple->value->int32;
-      const char *name = title_tuple->value->cstring;
-
-      // Read points and position
-      Tuple *points_tuple = dict_find(iterator, MESSAGE_KEY_DATA_POINTS);
-      Tuple *position_tuple = dict_find(iterator, MESSAGE_KEY_DATA_POSITION);
-      int points = points_tuple ? points_tuple->value->int32 : 0;
-      int position = position_tuple ? position_tuple->value->int32 : 0;
-
-      APP_LOG(APP_LOG_LEVEL_INFO, "Received team %d: %s - %d pts, P%d",
-              index, name, points, position);
-
-      if (s_team_standings_data_callback) {
-        s_team_standings_data_callback(index, name, points, position);
+  push_request(&(QueuedRequest){
+      .type = REQUEST_TYPE_CANCEL,
+      .index = id,
+      .id = next_request_id(),
+  });
+}
+
+// Drop queued requests the new one replaces, and cancel those the phone is
+// already working on
+static void cancel_superseded(const QueuedRequest *request) {
+  // The head is kept while it is being sent and cancelled once the queue is
+  // compacted, so the cancel goes out behind it
+  uint16_t sending_id = 0;
+  int kept = 0;
+  for (int i = 0; i < s_queue_count; i++) {
+    QueuedRequest queued = s_request_queue[(s_queue_head + i) % REQUEST_QUEUE_SIZE];
+    if (supersedes(request, &queued)) {
+      if (i == 0 && s_request_in_flight) {
+        sending_id = queued.id;
+      } else {
+        APP_LOG(APP_LOG_LEVEL_INFO, "Request %d (index %d) superseded",
+                (int)queued.type, queued.index);
+        if (i == 0) {
+          s_retry_attempts = 0;
+        }
+        continue;
       }
     }
-    break;
+    s_request_queue[(s_queue_head + kept++) % REQUEST_QUEUE_SIZE] = queued;
+  }
+  s_queue_count = kept;
 
-  default:
-    APP_LOG(APP_LOG_LEVEL_WARNING, "Unknown request type: %d",
-            (int)request_type);
-    break;
+  if (sending_id != 0) {
+    cancel_request(sending_id);
+  }
+
+  time_t now = time(NULL);
+  for (int i = 0; i < REQUEST_QUEUE_SIZE; i++) {
+    QueuedRequest *awaiting = &s_awaiting_reply[i];
+    if (is_awaiting_reply(awaiting, now) && supersedes(request, awaiting)) {
+      cancel_request(awaiting->id);
+    }
   }
 }
 
-// Message dropped handler
-static void inbox_dropped_callback(AppMessageResult reason, void *context) {
-  APP_LOG(APP_LOG_LEVEL_ERROR, "Message dropped: %d", (int)reason);
+static void enqueue_request(RequestType type, int index) {
+  if (is_request_pending(type, index)) {
+    APP_LOG(APP_LOG_LEVEL_INFO, "Request %d (index %d) already pending",
+            (int)type, index);
+    return;
+  }
+
+  QueuedRequest request = {
+      .type = type,
+      .index = index,
+      .id = next_request_id(),
+  };
+  cancel_superseded(&request);
+  if (push_request(&request)) {
+    send_next_request();
+  }
 }
 
 // Outbox sent handler
 static void outbox_sent_callback(DictionaryIterator *iterator, void *context) {
-  APP_LOG(APP_LOG_LEVEL_INFO, "Message sent successfully");
+  s_request_in_flight = false;
+  if (s_queue_count > 0) {
+    QueuedRequest *request = &s_request_queue[s_queue_head];
+    const RequestType *parts;
+    size_t part_count = request_parts(request->type, &parts);
+    if (request->type == REQUEST_TYPE_CANCEL || is_cancelled(request->id)) {
+      // No reply to wait for
+    } else if (part_count > 0) {
+      // Wait on each part separately, as each arrives as its own reply
+      for (size_t i = 0; i < part_count; i++) {
+        track_awaiting_reply(&(QueuedRequest){
+            .type = parts[i],
+            .index = request->index,
+            .id = request->id,
+        });
+      }
+    } else {
+      track_awaiting_reply(request);
+    }
+    pop_request();
+  }
+  send_next_request();
 }
 
 // Outbox failed handler
 static void outbox_failed_callback(DictionaryIterator *iterator,
                                    AppMessageResult reason, void *context) {
   APP_LOG(APP_LOG_LEVEL_ERROR, "Message send failed: %d", (int)reason);
+  s_request_in_flight = false;
+  schedule_retry();
+}
+
+static void app_connection_handler(bool connected) {
+  if (connected) {
+    // Start the backoff over now that the phone is reachable again
+    if (s_retry_timer) {
+      app_timer_cancel(s_retry_timer);
+      s_retry_timer = NULL;
+    }
+    s_retry_attempts = 0;
+    send_next_request();
+  }
 }
 
 void message_handler_init(void) {
@@ -194,172 +814,115 @@ void message_handler_init(void) {
   app_message_register_outbox_sent(outbox_sent_callback);
   app_message_register_outbox_failed(outbox_failed_callback);
 
+  connection_service_subscribe((ConnectionHandlers){
+      .pebble_app_connection_handler = app_connection_handler,
+  });
+
   APP_LOG(APP_LOG_LEVEL_INFO, "Message handler initialized");
 }
 
-void message_handler_deinit(void) { app_message_deregister_callbacks(); }
-
-void message_handler_request_overview(void) {
-  DictionaryIterator *iter;
-  AppMessageResult result = app_message_outbox_begin(&iter);
-
-  if (result == APP_MSG_OK) {
-    dict_write_uint8(iter, MESSAGE_KEY_REQUEST_TYPE, REQUEST_TYPE_GET_OVERVIEW);
-    result = app_message_outbox_send();
-
-    if (result == APP_MSG_OK) {
-      APP_LOG(APP_LOG_LEVEL_INFO, "Requested overview data");
-    } else {
-      APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to send overview request: %d",
-              (int)result);
-    }
-  } else {
-    APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to begin overview request: %d",
-            (int)result);
+void message_handler_deinit(void) {
+  connection_service_unsubscribe();
+  if (s_retry_timer) {
+    app_timer_cancel(s_retry_timer);
+    s_retry_timer = NULL;
   }
+  s_queue_count = 0;
+  s_request_in_flight = false;
+  memset(s_awaiting_reply, 0, sizeof(s_awaiting_reply));
+  reassembly_reset();
+  app_message_deregister_callbacks();
 }
 
-void message_handler_request_race_details(int race_index) {
-  DictionaryIterator *iter;
-  AppMessageResult result = app_message_outbox_begin(&iter);
+void message_handler_request_overview(void) {
+  enqueue_request(REQUEST_TYPE_GET_OVERVIEW, REQUEST_NO_INDEX);
+}
 
-  if (result == APP_MSG_OK) {
-    dict_write_uint8(iter, MESSAGE_KEY_REQUEST_TYPE,
-                     REQUEST_TYPE_GET_RACE_DETAILS);
-    dict_write_int32(iter, MESSAGE_KEY_DATA_INDEX, race_index);
-    result = app_message_outbox_send();
+void message_handler_request_bootstrap(void) {
+  enqueue_request(REQUEST_TYPE_GET_BOOTSTRAP, REQUEST_NO_INDEX);
+}
 
-    if (result == APP_MSG_OK) {
-      APP_LOG(APP_LOG_LEVEL_INFO, "Requested race details for index %d",
-              race_index);
-    } else {
-      APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to send race details request: %d",
-              (int)result);
-    }
-  } else {
-    APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to begin race details request: %d",
-            (int)result);
-  }
+void message_handler_request_race_weekend(int race_round) {
+  enqueue_request(REQUEST_TYPE_GET_RACE_WEEKEND, race_round);
 }
 
-void message_handler_set_overview_callbacks(
-    OverviewDataCallback data_cb, OverviewCompleteCallback complete_cb) {
-  s_overview_data_callback = data_cb;
-  s_overview_complete_callback = complete_cb;
+void message_handler_request_calendar(void) {
+  enqueue_request(REQUEST_TYPE_GET_CALENDAR, REQUEST_NO_INDEX);
 }
 
-void message_handler_set_race_details_callbacks(
-    RaceDetailsDataCallback data_cb, RaceDetailsCompleteCallback complete_cb) {
-  s_race_details_data_callback = data_cb;
-  s_race_details_complete_callback = complete_cb;
+void message_handler_request_race_details(int race_index) {
+  enqueue_request(REQUEST_TYPE_GET_RACE_DETAILS, race_index);
 }
 
 void message_handler_request_driver_standings(void) {
-  DictionaryIterator *iter;
-  AppMessageResult result = app_message_outbox_begin(&iter);
-
-  if (result == APP_MSG_OK) {
-    dict_write_uint8(iter, MESSAGE_KEY_REQUEST_TYPE,
-                     REQUEST_TYPE_GET_DRIVER_STANDINGS);
-    result = app_message_outbox_send();
-
-    if (result == APP_MSG_OK) {
-      APP_LOG(APP_LOG_LEVEL_INFO, "Requested driver standings");
-    } else {
-      APP_LOG(APP_LOG_LEVEL_ERROR,
-              "Failed to send driver standings request: %d", (int)result);
-    }
-  } else {
-    APP_LOG(APP_LOG_LEVEL_ERROR,
-            "Failed to begin driver standings request: %d", (int)result);
-  }
+  enqueue_request(REQUEST_TYPE_GET_DRIVER_STANDINGS, REQUEST_NO_INDEX);
 }
 
 void message_handler_request_team_standings(void) {
-  DictionaryIterator *iter;
-  AppMessageResult result = app_message_outbox_begin(&iter);
-
-  if (result == APP_MSG_OK) {
-    dict_write_uint8(iter, MESSAGE_KEY_REQUEST_TYPE,
-                     REQUEST_TYPE_GET_TEAM_STANDINGS);
-    result = app_message_outbox_send();
-
-    if (result == APP_MSG_OK) {
-      APP_LOG(APP_LOG_LEVEL_INFO, "Requested team standings");
-    } else {
-      APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to send team standings request: %d",
-              (int)result);
-    }
-  } else {
-    APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to begin team standings request: %d",
-            (int)result);
-  }
+  enqueue_request(REQUEST_TYPE_GET_TEAM_STANDINGS, REQUEST_NO_INDEX);
 }
 
 void message_handler_request_race_results(int race_round) {
-  DictionaryIterator *iter;
-  AppMessageResult result = app_message_outbox_begin(&iter);
+  enqueue_request(REQUEST_TYPE_GET_RACE_RESULTS, race_round);
+}
 
-  if (result == APP_MSG_OK) {
-    dict_write_uint8(iter, MESSAGE_KEY_REQUEST_TYPE,
-                     REQUEST_TYPE_GET_RACE_RESULTS);
-    dict_write_int32(iter, MESSAGE_KEY_DATA_INDEX, race_round);
-    result = app_message_outbox_send();
+void message_handler_request_qualifying_results(int race_round) {
+  enqueue_request(REQUEST_TYPE_GET_QUALIFYING_RESULTS, race_round);
+}
 
-    if (result == APP_MSG_OK) {
-      APP_LOG(APP_LOG_LEVEL_INFO, "Requested race results for round %d",
-              race_round);
-    } else {
-      APP_LOG(APP_LOG_LEVEL_ERROR,
-              "Failed to send race results request: %d", (int)result);
+bool message_handler_is_idle(void) {
+  if (s_queue_count > 0 || s_request_in_flight || s_reassembly.transfer_id >= 0) {
+    return false;
+  }
+
+  time_t now = time(NULL);
+  for (int i = 0; i < REQUEST_QUEUE_SIZE; i++) {
+    if (is_awaiting_reply(&s_awaiting_reply[i], now)) {
+      return false;
     }
-  } else {
-    APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to begin race results request: %d",
-            (int)result);
   }
+  return true;
 }
 
-void message_handler_request_qualifying_results(int race_round) {
-  DictionaryIterator *iter;
-  AppMessageResult result = app_message_outbox_begin(&iter);
+bool message_payload_is_complete(const MessagePayload *payload) {
+  return payload->chunk_index + 1 >= payload->chunk_count;
+}
 
-  if (result == APP_MSG_OK) {
-    dict_write_uint8(iter, MESSAGE_KEY_REQUEST_TYPE,
-                     REQUEST_TYPE_GET_QUALIFYING_RESULTS);
-    dict_write_int32(iter, MESSAGE_KEY_DATA_INDEX, race_round);
-    result = app_message_outbox_send();
+bool message_handler_subscribe(RequestType type, MessageHandlerCallback callback,
+                               void *context) {
+  Subscription *free_slot = NULL;
 
-    if (result == APP_MSG_OK) {
-      APP_LOG(APP_LOG_LEVEL_INFO, "Requested qualifying results for round %d",
-              race_round);
-    } else {
-      APP_LOG(APP_LOG_LEVEL_ERROR,
-              "Failed to send qualifying results request: %d", (int)result);
+  for (int i = 0; i < MAX_SUBSCRIPTIONS; i++) {
+    Subscription *subscription = &s_subscriptions[i];
+    if (subscription->callback == callback && subscription->type == type) {
+      subscription->context = context;
+      return true;
+    }
+    if (!subscription->callback && !free_slot) {
+      free_slot = subscription;
     }
-  } else {
-    APP_LOG(APP_LOG_LEVEL_ERROR,
-            "Failed to begin qualifying results request: %d", (int)result);
   }
-}
 
-void message_handler_set_driver_standings_callbacks(
-    DriverStandingsDataCallback data_cb,
-    DriverStandingsCompleteCallback complete_cb) {
-  s_driver_standings_data_callback = data_cb;
-  s_driver_standings_complete_callback = complete_cb;
-}
+  if (!free_slot) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "No free subscription slot for request %d",
+            (int)type);
+    return false;
+  }
 
-void message_handler_set_team_standings_callbacks(
-    TeamStandingsDataCallback data_cb, TeamStandingsCompleteCallback complete_cb) {
-  s_team_standings_data_callback = data_cb;
-  s_team_standings_complete_callback = complete_cb;
+  *free_slot = (Subscription){
+      .type = type,
+      .callback = callback,
+      .context = context,
+  };
+  return true;
 }
 
-void message_handler_set_overview_message_callback(
-    OverviewMessageCallback overview_cb) {
-  s_overview_message_callback = overview_cb;
-
-  if (s_overview_message_callback && s_cached_overview_present) {
-    s_overview_message_callback(s_cached_overview_text);
+void message_handler_unsubscribe(RequestType type,
+                                 MessageHandlerCallback callback) {
+  for (int i = 0; i < MAX_SUBSCRIPTIONS; i++) {
+    Subscription *subscription = &s_subscriptions[i];
+    if (subscription->callback == callback && subscription->type == type) {
+      *subscription = (Subscription){0};
+    }
   }
 }
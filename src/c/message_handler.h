@@ -9,26 +9,39 @@ typedef enum {
   REQUEST_TYPE_GET_DRIVER_STANDINGS = 3,
   REQUEST_TYPE_GET_TEAM_STANDINGS = 4,
   REQUEST_TYPE_GET_RACE_RESULTS = 5,
-  REQUEST_TYPE_GET_QUALIFYING_RESULTS = 6
+  REQUEST_TYPE_GET_QUALIFYING_RESULTS = 6,
+  REQUEST_TYPE_GET_CALENDAR = 7,
+  REQUEST_TYPE_GET_BOOTSTRAP = 8,
+  // Never requested on its own: the phone sends the dictionary ahead of any
+  // dataset that refers to ids the watch does not know yet
+  REQUEST_TYPE_GET_DICTIONARY = 9,
+  REQUEST_TYPE_GET_RACE_WEEKEND = 10,
+  // Sent by the message handler itself when a newer request supersedes one
+  // the phone is still answering; DATA_INDEX holds the superseded id
+  REQUEST_TYPE_CANCEL = 11
 } RequestType;
 
-// Callback types for different data
-typedef void (*OverviewDataCallback)(int index, const char *title,
-                                     const char *subtitle, const char *extra,
-                                     int round);
-typedef void (*OverviewCompleteCallback)(int count);
-typedef void (*RaceDetailsDataCallback)(int index, const char *title,
-                                        const char *subtitle,
-                                        const char *extra);
-typedef void (*RaceDetailsCompleteCallback)(int count);
-typedef void (*DriverStandingsDataCallback)(int index, const char *name,
-                                            const char *code, int points,
-                                            int position);
-typedef void (*DriverStandingsCompleteCallback)(int count);
-typedef void (*TeamStandingsDataCallback)(int index, const char *name,
-                                          int points, int position);
-typedef void (*TeamStandingsCompleteCallback)(int count);
-typedef void (*OverviewMessageCallback)(const char *overview_text);
+// A dataset payload delivered to subscribers. data is only valid for the
+// duration of the callback; round is 0 for season-wide datasets.
+//
+// Large datasets arrive as several chunks, each a complete wire payload
+// holding the next run of records. Subscribers get every chunk as it arrives
+// so they can render the first rows early: chunk_index 0 replaces the
+// current rows, later chunks append to them.
+typedef struct {
+  RequestType type;
+  int round;
+  const uint8_t *data;
+  size_t length;
+  int chunk_index;
+  int chunk_count;
+  // The phone will not change this round's data again, e.g. results of a
+  // race whose classification is settled
+  bool final;
+} MessagePayload;
+
+typedef void (*MessageHandlerCallback)(const MessagePayload *payload,
+                                       void *context);
 
 // Initialize message handler
 void message_handler_init(void);
@@ -36,23 +49,42 @@ void message_handler_init(void);
 // Deinitialize message handler
 void message_handler_deinit(void);
 
-// Request data from JS
+// Request data from JS. Requests are queued and sent one at a time, and are
+// retried with backoff if the phone is busy or unreachable. A request that is
+// already queued or awaiting its reply is not sent again; subscribers receive
+// the pending reply instead. A request for another round of the same data
+// supersedes an outstanding one: it is dropped from the queue or cancelled on
+// the phone, and any late reply to it is discarded unread.
 void message_handler_request_overview(void);
+
+// Ask for everything the dashboard links to (overview, calendar and both
+// standings) in one go. Each part is delivered and cached under its own
+// request type, and requests for those parts are coalesced until it arrives.
+void message_handler_request_bootstrap(void);
+
+// Ask for a round's schedule, race results and qualifying in one exchange.
+// Like the bootstrap, each part arrives under its own request type, so the
+// results screens of that round open from the cache.
+void message_handler_request_race_weekend(int race_round);
+
+void message_handler_request_calendar(void);
 void message_handler_request_race_details(int race_index);
 void message_handler_request_driver_standings(void);
 void message_handler_request_team_standings(void);
 void message_handler_request_race_results(int race_round);
 void message_handler_request_qualifying_results(int race_round);
 
-// Register callbacks
-void message_handler_set_overview_callbacks(
-    OverviewDataCallback data_cb, OverviewCompleteCallback complete_cb);
-void message_handler_set_race_details_callbacks(
-    RaceDetailsDataCallback data_cb, RaceDetailsCompleteCallback complete_cb);
-void message_handler_set_driver_standings_callbacks(
-    DriverStandingsDataCallback data_cb,
-    DriverStandingsCompleteCallback complete_cb);
-void message_handler_set_team_standings_callbacks(
-    TeamStandingsDataCallback data_cb, TeamStandingsCompleteCallback complete_cb);
-void message_handler_set_overview_message_callback(
-    OverviewMessageCallback overview_cb);
+// True when nothing is queued, being sent, awaiting its reply or arriving,
+// so background work can use the radio without delaying the user
+bool message_handler_is_idle(void);
+
+// True for the last chunk of a payload, once the whole dataset has arrived
+bool message_payload_is_complete(const MessagePayload *payload);
+
+// Route payloads of a request type to callback until unsubscribed. Several
+// subscribers may listen to the same type. Every payload is also written to
+// the dataset cache, so data arriving with no subscriber is not lost.
+bool message_handler_subscribe(RequestType type, MessageHandlerCallback callback,
+                               void *context);
+void message_handler_unsubscribe(RequestType type,
+                                 MessageHandlerCallback callback);
@@ -0,0 +1,133 @@
+#include "prefetch.h"
+#include "dataset_cache.h"
+#include "message_handler.h"
+#include <pebble.h>
+
+// Wait this long after the dashboard renders before the first prefetch, and
+// between polls while the radio is busy
+#define PREFETCH_IDLE_DELAY_MS 1500
+
+#define MAX_PREFETCH_ITEMS 5
+
+typedef struct {
+  RequestType type;
+  int round;
+} PrefetchItem;
+
+// Most likely next screen first
+static PrefetchItem s_items[MAX_PREFETCH_ITEMS];
+static int s_item_count = 0;
+static int s_next_item = 0;
+static AppTimer *s_timer = NULL;
+
+static void request_item(const PrefetchItem *item) {
+  switch (item->type) {
+  case REQUEST_TYPE_GET_RACE_RESULTS:
+    message_handler_request_race_results(item->round);
+    break;
+  case REQUEST_TYPE_GET_QUALIFYING_RESULTS:
+    message_handler_request_qualifying_results(item->round);
+    break;
+  case REQUEST_TYPE_GET_RACE_WEEKEND:
+    message_handler_request_race_weekend(item->round);
+    break;
+  case REQUEST_TYPE_GET_DRIVER_STANDINGS:
+    message_handler_request_driver_standings();
+    break;
+  case REQUEST_TYPE_GET_TEAM_STANDINGS:
+    message_handler_request_team_standings();
+    break;
+  default:
+    break;
+  }
+}
+
+// Whether everything the item's request would fill already arrived this
+// session, e.g. with the bootstrap or a race weekend
+static bool item_is_fresh(const PrefetchItem *item) {
+  switch (item->type) {
+  case REQUEST_TYPE_GET_RACE_RESULTS:
+    return dataset_cache_is_fresh(DATASET_RACE_RESULTS, item->round);
+  case REQUEST_TYPE_GET_QUALIFYING_RESULTS:
+    return dataset_cache_is_fresh(DATASET_QUALIFYING_RESULTS, item->round);
+  case REQUEST_TYPE_GET_RACE_WEEKEND:
+    return dataset_cache_is_fresh(DATASET_RACE_DETAILS, item->round) &&
+           dataset_cache_is_fresh(DATASET_RACE_RESULTS, item->round) &&
+           dataset_cache_is_fresh(DATASET_QUALIFYING_RESULTS, item->round);
+  case REQUEST_TYPE_GET_DRIVER_STANDINGS:
+    return dataset_cache_is_fresh(DATASET_DRIVER_STANDINGS, 0);
+  case REQUEST_TYPE_GET_TEAM_STANDINGS:
+    return dataset_cache_is_fresh(DATASET_TEAM_STANDINGS, 0);
+  default:
+    return true;
+  }
+}
+
+static void prefetch_timer_callback(void *context) {
+  s_timer = NULL;
+
+  // Skip anything that already arrived this session
+  while (s_next_item < s_item_count && item_is_fresh(&s_items[s_next_item])) {
+    s_next_item++;
+  }
+  if (s_next_item == s_item_count) {
+    return;
+  }
+
+  // Leave the radio to the user's own requests and try again later
+  if (message_handler_is_idle()) {
+    const PrefetchItem *item = &s_items[s_next_item++];
+    APP_LOG(APP_LOG_LEVEL_INFO, "Prefetching request %d round %d",
+            (int)item->type, item->round);
+    request_item(item);
+  }
+
+  s_timer = app_timer_register(PREFETCH_IDLE_DELAY_MS, prefetch_timer_callback, NULL);
+}
+
+static void add_item(RequestType type, int round) {
+  if (s_item_count < MAX_PREFETCH_ITEMS) {
+    s_items[s_item_count++] = (PrefetchItem){.type = type, .round = round};
+  }
+}
+
+void prefetch_schedule(int next_round) {
+  prefetch_cancel();
+
+  // The whole weekend, so the race window finds its schedule, results and
+  // qualifying current rather than just the schedule
+  if (next_round > 0) {
+    add_item(REQUEST_TYPE_GET_RACE_WEEKEND, next_round);
+  }
+  if (next_round > 1) {
+    add_item(REQUEST_TYPE_GET_RACE_RESULTS, next_round - 1);
+    add_item(REQUEST_TYPE_GET_QUALIFYING_RESULTS, next_round - 1);
+  }
+  add_item(REQUEST_TYPE_GET_DRIVER_STANDINGS, 0);
+  add_item(REQUEST_TYPE_GET_TEAM_STANDINGS, 0);
+
+  s_timer = app_timer_register(PREFETCH_IDLE_DELAY_MS, prefetch_timer_callback, NULL);
+}
+
+void prefetch_race_neighbours(int previous_round, int next_round) {
+  prefetch_cancel();
+
+  // Forward through the season is the likelier direction
+  if (next_round > 0) {
+    add_item(REQUEST_TYPE_GET_RACE_WEEKEND, next_round);
+  }
+  if (previous_round > 0) {
+    add_item(REQUEST_TYPE_GET_RACE_WEEKEND, previous_round);
+  }
+
+  s_timer = app_timer_register(PREFETCH_IDLE_DELAY_MS, prefetch_timer_callback, NULL);
+}
+
+void prefetch_cancel(void) {
+  if (s_timer) {
+    app_timer_cancel(s_timer);
+    s_timer = NULL;
+  }
+  s_item_count = 0;
+  s_next_item = 0;
+}
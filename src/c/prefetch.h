@@ -0,0 +1,21 @@
+#pragma once
+
+#include <pebble.h>
+
+// Fetches the screens the user is likely to open next while the radio is
+// idle, so they open from the dataset cache instead of waiting on the phone.
+// Requests go out one at a time and only when nothing else is in flight, so
+// anything the user asks for is never queued behind a prefetch.
+
+// Prefetch around the race the dashboard leads with: its race weekend, the
+// previous round's results and qualifying, and the standings. Replaces any
+// prefetch still running.
+void prefetch_schedule(int next_round);
+
+// Prefetch the race weekends either side of the race on screen, so stepping
+// to them opens from the cache. A round of 0 is skipped. Replaces any
+// prefetch still running.
+void prefetch_race_neighbours(int previous_round, int next_round);
+
+// Stop any pending prefetch
+void prefetch_cancel(void);
@@ -0,0 +1,26 @@
+#include "record_buffer.h"
+#include <pebble.h>
+
+bool record_buffer_reserve(void **records, int *capacity, int count,
+                           size_t record_size) {
+  if (count <= *capacity) {
+    return true;
+  }
+
+  void *grown = realloc(*records, count * record_size);
+  if (!grown) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "No memory for %d records of %d bytes",
+            count, (int)record_size);
+    return false;
+  }
+
+  *records = grown;
+  *capacity = count;
+  return true;
+}
+
+void record_buffer_free(void **records, int *capacity) {
+  free(*records);
+  *records = NULL;
+  *capacity = 0;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <pebble.h>
+
+// Grow a heap array of records so it holds at least count of them, keeping
+// the records already in it. Datasets call this with the record count each
+// payload announces, so memory follows the data instead of a fixed maximum.
+// Returns false, leaving the array untouched, if memory is short.
+bool record_buffer_reserve(void **records, int *capacity, int count,
+                           size_t record_size);
+
+// Free the array and reset its capacity
+void record_buffer_free(void **records, int *capacity);
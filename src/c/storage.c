@@ -0,0 +1,218 @@
+#include "storage.h"
+#include <pebble.h>
+
+// Persist key layout: every blob id owns STORAGE_KEYS_PER_BLOB consecutive
+// keys. The first key is the pointer holding the committed generation, the
+// rest are two banks of (header + chunks). Generation N lives in bank N % 2,
+// so a new write always goes into the bank that is not currently visible.
+#define STORAGE_KEY_BASE 1000
+#define STORAGE_KEYS_PER_BLOB 33
+#define STORAGE_KEYS_PER_BANK 16
+#define STORAGE_MAX_CHUNKS (STORAGE_KEYS_PER_BANK - 1)
+#define STORAGE_CHUNK_SIZE PERSIST_DATA_MAX_LENGTH
+
+_Static_assert(STORAGE_MAX_BLOB_SIZE <= STORAGE_MAX_CHUNKS * STORAGE_CHUNK_SIZE,
+               "a blob of the maximum size needs more keys than a bank has");
+
+// Bumped whenever the header layout changes; older headers are ignored
+#define STORAGE_FORMAT_VERSION 1
+
+typedef struct {
+  uint8_t format;
+  uint8_t chunk_count;
+  uint16_t length;
+  uint32_t generation;
+  uint32_t checksum;
+} StorageHeader;
+
+static uint32_t pointer_key(uint32_t blob_id) {
+  return STORAGE_KEY_BASE + blob_id * STORAGE_KEYS_PER_BLOB;
+}
+
+static uint32_t bank_header_key(uint32_t blob_id, uint32_t generation) {
+  return pointer_key(blob_id) + 1 + (generation % 2) * STORAGE_KEYS_PER_BANK;
+}
+
+static uint32_t bank_chunk_key(uint32_t blob_id, uint32_t generation, int chunk) {
+  return bank_header_key(blob_id, generation) + 1 + chunk;
+}
+
+static bool read_committed_header(uint32_t blob_id, StorageHeader *header) {
+  uint32_t key = pointer_key(blob_id);
+  if (!persist_exists(key)) {
+    return false;
+  }
+
+  uint32_t generation = (uint32_t)persist_read_int(key);
+  uint32_t header_key = bank_header_key(blob_id, generation);
+  if (persist_read_data(header_key, header, sizeof(*header)) != (int)sizeof(*header)) {
+    return false;
+  }
+
+  return header->format == STORAGE_FORMAT_VERSION &&
+         header->generation == generation &&
+         header->chunk_count <= STORAGE_MAX_CHUNKS;
+}
+
+static void delete_bank(uint32_t blob_id, uint32_t generation) {
+  persist_delete(bank_header_key(blob_id, generation));
+  for (int i = 0; i < STORAGE_MAX_CHUNKS; i++) {
+    uint32_t key = bank_chunk_key(blob_id, generation, i);
+    if (persist_exists(key)) {
+      persist_delete(key);
+    }
+  }
+}
+
+// Committed bytes of every blob except blob_id
+static size_t other_blobs_length(uint32_t blob_id) {
+  size_t length = 0;
+  for (uint32_t id = 0; id < STORAGE_MAX_BLOBS; id++) {
+    StorageHeader header;
+    if (id != blob_id && read_committed_header(id, &header)) {
+      length += header.length;
+    }
+  }
+  return length;
+}
+
+// Delete less important blobs, least important first, until needed more
+// bytes fit the budget alongside the blobs that are left
+static bool make_room(uint32_t blob_id, size_t needed) {
+  size_t used = other_blobs_length(blob_id);
+  for (uint32_t id = STORAGE_MAX_BLOBS - 1;
+       id > blob_id && used + needed > STORAGE_BUDGET_BYTES; id--) {
+    StorageHeader header;
+    if (read_committed_header(id, &header)) {
+      APP_LOG(APP_LOG_LEVEL_INFO, "Evicting blob %d (%d bytes) for blob %d",
+              (int)id, (int)header.length, (int)blob_id);
+      storage_delete_blob(id);
+      used -= header.length;
+    }
+  }
+  return used + needed <= STORAGE_BUDGET_BYTES;
+}
+
+uint32_t storage_checksum(const void *data, size_t length) {
+  const uint8_t *bytes = data;
+  uint32_t hash = 2166136261u;
+
+  for (size_t i = 0; i < length; i++) {
+    hash ^= bytes[i];
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+bool storage_write_blob(uint32_t blob_id, const void *data, size_t length) {
+  if (!data || blob_id >= STORAGE_MAX_BLOBS || length > STORAGE_MAX_BLOB_SIZE) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Blob %d too large to store (%d bytes)",
+            (int)blob_id, (int)length);
+    return false;
+  }
+
+  StorageHeader current;
+  bool has_current = read_committed_header(blob_id, &current);
+  uint32_t generation = has_current ? current.generation + 1 : 1;
+
+  // The current copy stays until the commit, so it counts as well
+  if (!make_room(blob_id, length + (has_current ? current.length : 0))) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "No room to store blob %d (%d bytes)",
+            (int)blob_id, (int)length);
+    return false;
+  }
+
+  // Clear out whatever a torn write may have left in the target bank
+  delete_bank(blob_id, generation);
+
+  const uint8_t *bytes = data;
+  int chunk_count = (length + STORAGE_CHUNK_SIZE - 1) / STORAGE_CHUNK_SIZE;
+  for (int i = 0; i < chunk_count; i++) {
+    size_t offset = i * STORAGE_CHUNK_SIZE;
+    size_t chunk_length = length - offset;
+    if (chunk_length > STORAGE_CHUNK_SIZE) {
+      chunk_length = STORAGE_CHUNK_SIZE;
+    }
+
+    if (persist_write_data(bank_chunk_key(blob_id, generation, i),
+                           bytes + offset, chunk_length) < 0) {
+      APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to write blob %d chunk %d",
+              (int)blob_id, i);
+      delete_bank(blob_id, generation);
+      return false;
+    }
+  }
+
+  StorageHeader header = {
+      .format = STORAGE_FORMAT_VERSION,
+      .chunk_count = (uint8_t)chunk_count,
+      .length = (uint16_t)length,
+      .generation = generation,
+      .checksum = storage_checksum(data, length),
+  };
+  if (persist_write_data(bank_header_key(blob_id, generation), &header,
+                         sizeof(header)) < 0) {
+    delete_bank(blob_id, generation);
+    return false;
+  }
+
+  // Commit point: readers follow the pointer, so the new copy becomes
+  // visible atomically here
+  if (persist_write_int(pointer_key(blob_id), (int32_t)generation) < 0) {
+    delete_bank(blob_id, generation);
+    return false;
+  }
+
+  if (has_current) {
+    delete_bank(blob_id, current.generation);
+  }
+
+  return true;
+}
+
+int storage_blob_length(uint32_t blob_id) {
+  StorageHeader header;
+  if (!read_committed_header(blob_id, &header)) {
+    return -1;
+  }
+
+  return header.length;
+}
+
+int storage_read_blob(uint32_t blob_id, void *buffer, size_t buffer_size) {
+  StorageHeader header;
+  if (!buffer || !read_committed_header(blob_id, &header) ||
+      header.length > buffer_size) {
+    return -1;
+  }
+
+  uint8_t *bytes = buffer;
+  size_t offset = 0;
+  for (int i = 0; i < header.chunk_count; i++) {
+    size_t chunk_length = header.length - offset;
+    if (chunk_length > STORAGE_CHUNK_SIZE) {
+      chunk_length = STORAGE_CHUNK_SIZE;
+    }
+
+    if (persist_read_data(bank_chunk_key(blob_id, header.generation, i),
+                          bytes + offset, chunk_length) != (int)chunk_length) {
+      return -1;
+    }
+    offset += chunk_length;
+  }
+
+  if (offset != header.length ||
+      storage_checksum(buffer, header.length) != header.checksum) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "Blob %d failed verification", (int)blob_id);
+    return -1;
+  }
+
+  return header.length;
+}
+
+void storage_delete_blob(uint32_t blob_id) {
+  delete_bank(blob_id, 0);
+  delete_bank(blob_id, 1);
+  persist_delete(pointer_key(blob_id));
+}
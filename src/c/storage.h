@@ -0,0 +1,41 @@
+#pragma once
+
+#include <pebble.h>
+
+// Bytes all blobs may hold together. Pebble allows about 4 KB of persist
+// data per app; the rest is left for keys, headers and pointers. Override at
+// build time for a platform with a different limit.
+#ifndef STORAGE_BUDGET_BYTES
+#define STORAGE_BUDGET_BYTES 3072
+#endif
+
+// Blob ids run from 0 to STORAGE_MAX_BLOBS - 1 and also rank the blobs:
+// lower ids are more important and are evicted last
+#define STORAGE_MAX_BLOBS 8
+
+// A write keeps the current copy until the new one is committed, so a blob
+// may use at most half the budget to be replaceable at all
+#define STORAGE_MAX_BLOB_SIZE (STORAGE_BUDGET_BYTES / 2)
+
+// Write a blob under blob_id, splitting it across numbered persist keys.
+// The new copy is written next to the current one and only becomes visible
+// once the pointer key is flipped, so a torn write leaves the old copy intact.
+// Both copies count against STORAGE_BUDGET_BYTES while it is written; blobs
+// with higher ids are deleted, highest first, until they fit. Returns false
+// if the blob is too large, or would only fit by evicting a more important
+// one, or storage is full.
+bool storage_write_blob(uint32_t blob_id, const void *data, size_t length);
+
+// Length of the committed blob, or -1 if there is none
+int storage_blob_length(uint32_t blob_id);
+
+// Read the committed blob chunk by chunk into buffer and verify its checksum.
+// Returns the number of bytes read, or -1 if the blob is missing, does not
+// fit in buffer_size or fails verification.
+int storage_read_blob(uint32_t blob_id, void *buffer, size_t buffer_size);
+
+// Delete a blob and every key it occupies
+void storage_delete_blob(uint32_t blob_id);
+
+// 32-bit FNV-1a checksum used to verify blobs
+uint32_t storage_checksum(const void *data, size_t length);
@@ -0,0 +1,63 @@
+#include "string_arena.h"
+#include <pebble.h>
+
+void string_arena_reset(StringArena *arena) {
+  if (arena->buffer) {
+    arena->buffer[0] = '\0';
+    arena->used = 1;
+  }
+}
+
+bool string_arena_reserve(StringArena *arena, size_t length) {
+  // Offset 0 is the shared empty string
+  size_t used = arena->used > 0 ? arena->used : 1;
+  size_t size = used + length;
+  if (size <= arena->size) {
+    return true;
+  }
+
+  if (size > UINT16_MAX) {
+    return false;
+  }
+
+  char *buffer = realloc(arena->buffer, size);
+  if (!buffer) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "No memory for %d bytes of strings", (int)size);
+    return false;
+  }
+
+  arena->buffer = buffer;
+  arena->size = size;
+  if (arena->used == 0) {
+    string_arena_reset(arena);
+  }
+  return true;
+}
+
+void string_arena_destroy(StringArena *arena) {
+  free(arena->buffer);
+  *arena = (StringArena){0};
+}
+
+ArenaString string_arena_add(StringArena *arena, const char *data, size_t length) {
+  if (length == 0 || arena->used == 0 || arena->used + length + 1 > arena->size) {
+    if (length > 0) {
+      APP_LOG(APP_LOG_LEVEL_WARNING, "String arena full (%d bytes)",
+              (int)arena->size);
+    }
+    return 0;
+  }
+
+  ArenaString string = arena->used;
+  memcpy(&arena->buffer[string], data, length);
+  arena->buffer[string + length] = '\0';
+  arena->used += length + 1;
+  return string;
+}
+
+const char *string_arena_get(const StringArena *arena, ArenaString string) {
+  if (string >= arena->used) {
+    return "";
+  }
+  return &arena->buffer[string];
+}
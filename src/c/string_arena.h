@@ -0,0 +1,31 @@
+#pragma once
+
+#include <pebble.h>
+
+// Strings of one dataset packed end to end in a single heap buffer. Records
+// keep a 16-bit offset instead of a fixed-size char array, so each string
+// only costs its own length plus a terminator, and offsets stay valid when
+// the buffer grows. Offset 0 always reads as "", which is also what a string
+// that did not fit reads as. A zeroed StringArena is empty and ready to use.
+typedef struct {
+  char *buffer;
+  uint16_t size;
+  uint16_t used;
+} StringArena;
+
+typedef uint16_t ArenaString;
+
+// Forget every string; call before parsing a fresh copy of the dataset
+void string_arena_reset(StringArena *arena);
+
+// Make room for at least length more bytes of strings. A payload's length is
+// always enough for the strings in it. Returns false if memory is short.
+bool string_arena_reserve(StringArena *arena, size_t length);
+
+// Release the buffer, leaving an empty arena
+void string_arena_destroy(StringArena *arena);
+
+// Append length bytes of data as a NUL-terminated string
+ArenaString string_arena_add(StringArena *arena, const char *data, size_t length);
+
+const char *string_arena_get(const StringArena *arena, ArenaString string);
@@ -20,6 +20,8 @@
 // ---------------------------------------------------------------------------
 #define MENU_CELL_HEIGHT    28
 #define MENU_HEADER_HEIGHT  50
+// Title strip above each section of a menu split into sections
+#define MENU_SECTION_HEADER_HEIGHT 18
 // Fixed width reserved for the position number column (fits "20" in GOTHIC_18_BOLD)
 #define MENU_ROW_POS_WIDTH  22
 // Gap between position column and name
@@ -50,13 +52,8 @@
 #define DASHBOARD_ROW_FONT          MENU_ROW_FONT
 #define RACE_WINDOW_ROW_FONT        MENU_ROW_FONT
 #define RACE_WINDOW_SECONDARY_FONT  MENU_ROW_SECONDARY_FONT
-#define RESULTS_RACE_WINDOW_ROW_FONT MENU_ROW_FONT
-#define RESULTS_RACE_WINDOW_SECONDARY_FONT MENU_ROW_SECONDARY_FONT
-#define RESULTS_QUALIFYING_WINDOW_ROW_FONT MENU_ROW_FONT
-#define RESULTS_QUALIFYING_WINDOW_SECONDARY_FONT MENU_ROW_SECONDARY_FONT
-#define TEAM_STANDINGS_WINDOW_ROW_FONT MENU_ROW_FONT
-#define DRIVER_STANDINGS_WINDOW_ROW_FONT MENU_ROW_FONT
-#define CALENDAR_WINDOW_ROW_FONT    MENU_ROW_FONT
+#define LIST_WINDOW_ROW_FONT        MENU_ROW_FONT
+#define LIST_WINDOW_SECONDARY_FONT  MENU_ROW_SECONDARY_FONT
 
 // fonts_load_custom_font(resource_get_handle(RESOURCE_ID_ROBOTO_MONO_LIGHT_14))
 // fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD)
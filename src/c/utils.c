@@ -2,6 +2,22 @@
 #include <pebble.h>
 #include <stdint.h>
 
+#define SECONDS_PER_DAY 86400
+
+// Local UTC offset in seconds, read once per session and refreshed by
+// utils_refresh_utc_offset() so conversions are plain arithmetic
+static int32_t s_utc_offset = 0;
+static bool s_utc_offset_valid = false;
+
+// Calendar fields of a timestamp, without going through localtime()
+typedef struct {
+  int year;
+  int month; // 1-12
+  int day;
+  int hour;
+  int minute;
+} DateTimeParts;
+
 const char *utils_get_month_abbr(int month) {
   static const char *months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
                                  "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
@@ -12,287 +28,174 @@ const char *utils_get_month_abbr(int month) {
   return "???";
 }
 
-// Simple manual string parsing to avoid sscanf
-static int parse_int(const char *str, int *pos, int len) {
-  int val = 0;
-  for (int i = 0; i < len && str[*pos] >= '0' && str[*pos] <= '9';
-       i++, (*pos)++) {
-    val = val * 10 + (str[*pos] - '0');
-  }
-  return val;
-}
-
-static bool parse_iso_datetime(const char *iso_datetime, int *year, int *month,
-                               int *day, int *hour, int *minute,
-                               int *second) {
-  if (!iso_datetime || !year || !month || !day || !hour || !minute || !second) {
-    return false;
-  }
-
-  int pos = 0;
-  *year = parse_int(iso_datetime, &pos, 4);
-  if (iso_datetime[pos] != '-') return false;
-  pos++;
-  *month = parse_int(iso_datetime, &pos, 2);
-  if (iso_datetime[pos] != '-') return false;
-  pos++;
-  *day = parse_int(iso_datetime, &pos, 2);
-  if (iso_datetime[pos] != 'T') return false;
-  pos++;
-  *hour = parse_int(iso_datetime, &pos, 2);
-  if (iso_datetime[pos] != ':') return false;
-  pos++;
-  *minute = parse_int(iso_datetime, &pos, 2);
-  *second = 0;
-
-  if (iso_datetime[pos] == ':') {
-    pos++;
-    *second = parse_int(iso_datetime, &pos, 2);
-  }
+bool utils_refresh_utc_offset(void) {
+  time_t now = time(NULL);
+  struct tm *local_tm = localtime(&now);
+  int32_t offset = local_tm ? (int32_t)local_tm->tm_gmtoff : 0;
 
-  return true;
+  bool changed = !s_utc_offset_valid || offset != s_utc_offset;
+  s_utc_offset = offset;
+  s_utc_offset_valid = true;
+  return changed;
 }
 
-static bool iso_datetime_to_epoch_utc(const char *iso_datetime, time_t *output) {
-  if (!iso_datetime || !output) {
-    return false;
+int32_t utils_utc_offset(void) {
+  if (!s_utc_offset_valid) {
+    utils_refresh_utc_offset();
   }
+  return s_utc_offset;
+}
 
-  int year, month, day, hour, minute, second;
-  if (!parse_iso_datetime(iso_datetime, &year, &month, &day, &hour, &minute, &second)) {
-    return false;
-  }
-
-  int64_t y = year;
-  int64_t m = month;
-  int64_t d = day;
-  int64_t H = hour;
-  int64_t M = minute;
-  int64_t S = second;
-
-  if (m <= 2) {
-    y -= 1;
-    m += 12;
+// Floor division so times before the epoch still land on the right day
+static int64_t floor_div(int64_t value, int64_t divisor) {
+  int64_t quotient = value / divisor;
+  if ((value % divisor != 0) && ((value < 0) != (divisor < 0))) {
+    quotient--;
   }
+  return quotient;
+}
 
-  int64_t era = y / 400;
-  int64_t yoe = y - era * 400;
-  int64_t doy = (153 * (m - 3) + 2) / 5 + d - 1;
-  int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
-  int64_t days_since_epoch = era * 146097 + doe - 719468;
-  int64_t seconds_since_epoch = days_since_epoch * 86400 + H * 3600 + M * 60 + S;
+// Split seconds since 1970 (in whatever zone the caller has applied) into
+// calendar fields using the days-to-civil algorithm
+static void split_time(int64_t seconds, DateTimeParts *parts) {
+  int64_t days = floor_div(seconds, SECONDS_PER_DAY);
+  int64_t second_of_day = seconds - days * SECONDS_PER_DAY;
+
+  int64_t z = days + 719468;
+  int64_t era = floor_div(z, 146097);
+  int64_t doe = z - era * 146097;
+  int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  int64_t mp = (5 * doy + 2) / 153;
+  int64_t month = mp < 10 ? mp + 3 : mp - 9;
+
+  parts->year = (int)(yoe + era * 400 + (month <= 2 ? 1 : 0));
+  parts->month = (int)month;
+  parts->day = (int)(doy - (153 * mp + 2) / 5 + 1);
+  parts->hour = (int)(second_of_day / 3600);
+  parts->minute = (int)((second_of_day % 3600) / 60);
+}
 
-  *output = (time_t)seconds_since_epoch;
-  return true;
+static void split_local_time(time_t utc_time, DateTimeParts *parts) {
+  split_time((int64_t)utc_time + utils_utc_offset(), parts);
 }
 
-void utils_format_datetime(const char *iso_datetime, char *output,
-                           size_t output_size) {
-  if (!iso_datetime || !output || output_size < 20) {
-    return;
-  }
+int utils_local_day(time_t utc_time) {
+  return (int)floor_div((int64_t)utc_time + utils_utc_offset(), SECONDS_PER_DAY);
+}
 
-  time_t utc_epoch;
-  if (!iso_datetime_to_epoch_utc(iso_datetime, &utc_epoch)) {
-    output[0] = '\0';
+void utils_format_datetime(time_t utc_time, char *output, size_t output_size) {
+  if (!output || output_size < 20) {
     return;
   }
 
-  struct tm *local_tm = localtime(&utc_epoch);
-  if (!local_tm) {
-    output[0] = '\0';
-    return;
-  }
+  DateTimeParts local;
+  split_local_time(utc_time, &local);
 
-  int month = local_tm->tm_mon + 1;
-  int day = local_tm->tm_mday;
-  int hour = local_tm->tm_hour;
-  int minute = local_tm->tm_min;
-  const char *am_pm = hour >= 12 ? "PM" : "AM";
-  int display_hour = hour % 12;
+  int display_hour = local.hour % 12;
   if (display_hour == 0) {
     display_hour = 12;
   }
 
-  const char *month_abbr = utils_get_month_abbr(month);
-  size_t out_pos = 0;
-
-  for (size_t i = 0; month_abbr[i] && out_pos < output_size - 1; i++) {
-    output[out_pos++] = month_abbr[i];
-  }
-  output[out_pos++] = ' ';
-
-  if (day >= 10) {
-    output[out_pos++] = '0' + (day / 10);
-  }
-  output[out_pos++] = '0' + (day % 10);
-  output[out_pos++] = ',';
-  output[out_pos++] = ' ';
-
-  if (display_hour >= 10) {
-    output[out_pos++] = '0' + (display_hour / 10);
-  }
-  output[out_pos++] = '0' + (display_hour % 10);
-  output[out_pos++] = ':';
-  output[out_pos++] = '0' + (minute / 10);
-  output[out_pos++] = '0' + (minute % 10);
-  output[out_pos++] = ' ';
-  output[out_pos++] = am_pm[0];
-  output[out_pos++] = am_pm[1];
-  output[out_pos] = '\0';
+  snprintf(output, output_size, "%s %d, %d:%02d %s",
+           utils_get_month_abbr(local.month), local.day, display_hour,
+           local.minute, local.hour >= 12 ? "PM" : "AM");
 }
 
-void utils_format_datetime_preferred(const char *iso_datetime, char *output,
+void utils_format_datetime_preferred(time_t utc_time, char *output,
                                      size_t output_size) {
-  if (!iso_datetime || !output || output_size < 20) {
-    return;
-  }
-
-  time_t utc_epoch;
-  if (!iso_datetime_to_epoch_utc(iso_datetime, &utc_epoch)) {
-    output[0] = '\0';
+  if (!output || output_size < 20) {
     return;
   }
 
-  struct tm *local_tm = localtime(&utc_epoch);
-  if (!local_tm) {
-    output[0] = '\0';
-    return;
-  }
-
-  int month = local_tm->tm_mon + 1;
-  int day = local_tm->tm_mday;
-  int hour = local_tm->tm_hour;
-  int minute = local_tm->tm_min;
-  const char *month_abbr = utils_get_month_abbr(month);
-  size_t out_pos = 0;
-
-  for (size_t i = 0; month_abbr[i] && out_pos < output_size - 1; i++) {
-    output[out_pos++] = month_abbr[i];
-  }
-  output[out_pos++] = ' ';
-
-  if (day >= 10) {
-    output[out_pos++] = '0' + (day / 10);
-  }
-  output[out_pos++] = '0' + (day % 10);
-  output[out_pos++] = ',';
-  output[out_pos++] = ' ';
-
   if (clock_is_24h_style()) {
-    output[out_pos++] = '0' + (hour / 10);
-    output[out_pos++] = '0' + (hour % 10);
+    DateTimeParts local;
+    split_local_time(utc_time, &local);
+    snprintf(output, output_size, "%s %d, %02d:%02d",
+             utils_get_month_abbr(local.month), local.day, local.hour,
+             local.minute);
   } else {
-    const char *am_pm = hour >= 12 ? "PM" : "AM";
-    int display_hour = hour % 12;
-    if (display_hour == 0) {
-      display_hour = 12;
-    }
-
-    if (display_hour >= 10) {
-      output[out_pos++] = '0' + (display_hour / 10);
-    }
-    output[out_pos++] = '0' + (display_hour % 10);
-    output[out_pos++] = ' ';
-    output[out_pos++] = am_pm[0];
-    output[out_pos++] = am_pm[1];
+    utils_format_datetime(utc_time, output, output_size);
   }
-
-  output[out_pos++] = ':';
-  output[out_pos++] = '0' + (minute / 10);
-  output[out_pos++] = '0' + (minute % 10);
-  output[out_pos] = '\0';
 }
 
-void utils_format_date(const char *iso_date, char *output, size_t output_size) {
-  if (!iso_date || !output || output_size < 15) {
+void utils_format_date(time_t date, char *output, size_t output_size) {
+  if (!output || output_size < 15) {
     return;
   }
 
-  // Parse ISO date manually: "2025-03-14"
-  int pos = 0;
-  int year = parse_int(iso_date, &pos, 4);
-  pos++; // skip '-'
-  int month = parse_int(iso_date, &pos, 2);
-  pos++; // skip '-'
-  int day = parse_int(iso_date, &pos, 2);
-
-  // Format manually
-  const char *month_abbr = utils_get_month_abbr(month);
-  size_t out_pos = 0;
-
-  // Month
-  for (size_t i = 0; month_abbr[i] && out_pos < output_size - 1; i++) {
-    output[out_pos++] = month_abbr[i];
-  }
-  output[out_pos++] = ' ';
-
-  // Day
-  if (day >= 10)
-    output[out_pos++] = '0' + (day / 10);
-  output[out_pos++] = '0' + (day % 10);
-  output[out_pos++] = ',';
-  output[out_pos++] = ' ';
-
-  // Year
-  output[out_pos++] = '0' + (year / 1000);
-  output[out_pos++] = '0' + ((year / 100) % 10);
-  output[out_pos++] = '0' + ((year / 10) % 10);
-  output[out_pos++] = '0' + (year % 10);
-
-  output[out_pos] = '\0';
+  // Dates are midnight UTC of the calendar day, so no offset is applied
+  DateTimeParts parts;
+  split_time((int64_t)date, &parts);
+
+  snprintf(output, output_size, "%s %d, %d", utils_get_month_abbr(parts.month),
+           parts.day, parts.year);
 }
 
-void utils_format_datetime_compact(const char *iso_datetime, char *output,
+void utils_format_datetime_compact(time_t utc_time, char *output,
                                    size_t output_size) {
-  if (!iso_datetime || !output || output_size < 12) {
+  if (!output || output_size < 12) {
     return;
   }
 
-  time_t utc_epoch;
-  if (!iso_datetime_to_epoch_utc(iso_datetime, &utc_epoch)) {
-    output[0] = '\0';
-    return;
-  }
+  DateTimeParts local;
+  split_local_time(utc_time, &local);
 
-  struct tm *local_tm = localtime(&utc_epoch);
-  if (!local_tm) {
-    output[0] = '\0';
+  snprintf(output, output_size, "%02d/%02d %02d:%02d", local.day, local.month,
+           local.hour, local.minute);
+}
+
+void utils_format_datetime_large(time_t utc_time, char *output,
+                                 size_t output_size) {
+  if (!output || output_size < 14) {
     return;
   }
 
-  int month = local_tm->tm_mon + 1;
-  int day = local_tm->tm_mday;
-  int hour = local_tm->tm_hour;
-  int minute = local_tm->tm_min;
+  DateTimeParts local;
+  split_local_time(utc_time, &local);
 
-  snprintf(output, output_size, "%02d/%02d %02d:%02d", day, month, hour, minute);
+  snprintf(output, output_size, "%s %d, %02d:%02d",
+           utils_get_month_abbr(local.month), local.day, local.hour,
+           local.minute);
 }
 
-void utils_format_datetime_large(const char *iso_datetime, char *output,
-                                 size_t output_size) {
-  if (!iso_datetime || !output || output_size < 14) {
+void utils_format_driver_name(const char *full_name, char *output,
+                              size_t output_size) {
+  if (!full_name || !output || output_size < 4) {
     return;
   }
 
-  time_t utc_epoch;
-  if (!iso_datetime_to_epoch_utc(iso_datetime, &utc_epoch)) {
-    output[0] = '\0';
+  // Find the space between first and last name
+  const char *space = strchr(full_name, ' ');
+  if (!space) {
+    // No space found, just copy the name
+    strncpy(output, full_name, output_size - 1);
+    output[output_size - 1] = '\0';
     return;
   }
 
-  struct tm *local_tm = localtime(&utc_epoch);
-  if (!local_tm) {
-    output[0] = '\0';
-    return;
+  // Format as "F.Lastname", truncating the last name if needed
+  const char *last_name = space + 1;
+  size_t pos = 0;
+  output[pos++] = full_name[0];
+  output[pos++] = '.';
+
+  while (*last_name && pos < output_size - 2) {
+    output[pos++] = *last_name++;
   }
 
-  int month = local_tm->tm_mon + 1;
-  int day = local_tm->tm_mday;
-  int hour = local_tm->tm_hour;
-  int minute = local_tm->tm_min;
-  const char *month_abbr = utils_get_month_abbr(month);
+  output[pos] = '\0';
+}
 
-  snprintf(output, output_size, "%s %d, %02d:%02d",
-           month_abbr, day, hour, minute);
+void utils_format_points(uint16_t tenths, char *output, size_t output_size) {
+  if (tenths % 10) {
+    snprintf(output, output_size, "%d.%d", tenths / 10, tenths % 10);
+  } else {
+    snprintf(output, output_size, "%d", tenths / 10);
+  }
+}
+
+int32_t utils_time_format_signature(void) {
+  utils_refresh_utc_offset();
+  return s_utc_offset * 2 + (clock_is_24h_style() ? 1 : 0);
 }
@@ -2,34 +2,58 @@
 
 #include <pebble.h>
 
-// Format datetime from ISO string to readable format
-// Input: "2025-03-14T01:30:00Z"
-// Output: "Mar 14, 1:30 AM" (in local timezone)
-void utils_format_datetime(const char *iso_datetime, char *output,
-                           size_t output_size);
-
-// Format datetime from ISO string using the device's 12/24h preference
-// Input: "2025-03-14T01:30:00Z"
+// Times are UTC epoch seconds, converted once when a payload is parsed.
+// Local formatting applies a UTC offset cached for the session instead of
+// calling localtime() for every value.
+
+// Re-read the local UTC offset. Returns true if it changed (or was not yet
+// known). Call when the timezone may have changed, e.g. on window appear.
+bool utils_refresh_utc_offset(void);
+
+// Cached local UTC offset in seconds
+int32_t utils_utc_offset(void);
+
+// Days since 1970-01-01 in local time, for comparing calendar days
+int utils_local_day(time_t utc_time);
+
+// Format a UTC time as local time
+// Output: "Mar 14, 1:30 AM"
+void utils_format_datetime(time_t utc_time, char *output, size_t output_size);
+
+// Format a UTC time as local time using the device's 12/24h preference
 // Output: "Mar 14, 13:30" or "Mar 14, 1:30 PM"
-void utils_format_datetime_preferred(const char *iso_datetime, char *output,
+void utils_format_datetime_preferred(time_t utc_time, char *output,
                                      size_t output_size);
 
-// Format date from ISO string
-// Input: "2025-03-14"
+// Format a date stored as midnight UTC of that day
 // Output: "Mar 14, 2025"
-void utils_format_date(const char *iso_date, char *output, size_t output_size);
+void utils_format_date(time_t date, char *output, size_t output_size);
 
 // Get month abbreviation
 const char *utils_get_month_abbr(int month);
 
-// Format datetime from ISO string to compact form
-// Input: "2025-07-12T18:30:00Z"
+// Format a UTC time as local time in compact form
 // Output: "12/07 18:30"
-void utils_format_datetime_compact(const char *iso_datetime, char *output,
+void utils_format_datetime_compact(time_t utc_time, char *output,
                                    size_t output_size);
 
-// Format datetime from ISO string for larger displays
-// Input: "2025-07-12T18:30:00Z"
+// Format a UTC time as local time for larger displays
 // Output: "Jul 12, 18:30"
-void utils_format_datetime_large(const char *iso_datetime, char *output,
+void utils_format_datetime_large(time_t utc_time, char *output,
                                  size_t output_size);
+
+// Abbreviate a full name for narrow columns
+// Input: "Max Verstappen"
+// Output: "M.Verstappen" (truncated to fit output_size)
+void utils_format_driver_name(const char *full_name, char *output,
+                              size_t output_size);
+
+// Format points held in tenths, showing the decimal only for half points
+// Input: 250 or 125
+// Output: "25" or "12.5"
+void utils_format_points(uint16_t tenths, char *output, size_t output_size);
+
+// A value that changes whenever the 12/24h preference or the local UTC offset
+// changes, so preformatted local times can be rebuilt only when needed.
+// Refreshes the cached offset.
+int32_t utils_time_format_signature(void);
@@ -6,7 +6,10 @@
 #include "team_standings_window.h"
 #include "../colors.h"
 #include "../data_models.h"
+#include "../dataset_cache.h"
 #include "../message_handler.h"
+#include "../prefetch.h"
+#include "../wire_format.h"
 #include "../ui_constants.h"
 #include "../utils.h"
 #include <pebble.h>
@@ -16,18 +19,27 @@
 #define DASHBOARD_ICON_SIZE 14
 #define DASHBOARD_ICON_GAP 4
 #define DASHBOARD_LOADING_ANIM_MS 220
+#define DASHBOARD_LOADING_WIDTH 40
+#define DASHBOARD_LOADING_HEIGHT 24
 
 static Window *s_window;
 static MenuLayer *s_menu_layer;
-static AppTimer *s_overview_retry_timer;
+static Layer *s_loading_layer;
 static AppTimer *s_loading_timer;
+static bool s_app_focused = true;
+// On top of the window stack, not covered by another window
+static bool s_window_visible = false;
 static char s_subtitle_text[32];
 
 static bool s_overview_loaded = false;
+static bool s_overview_live = false;
 static uint8_t s_loading_phase = 0;
 static int s_race_round = 0;
 static char s_race_name[MAX_TITLE_LENGTH] = "";
-static char s_race_datetime[64] = "";
+static time_t s_race_time = 0;
+static char s_round_text[20] = "";
+static char s_datetime_text[64] = "";
+static int32_t s_time_format_signature = 0;
 
 typedef enum {
   DASHBOARD_ICON_NONE = 0,
@@ -36,107 +48,164 @@ typedef enum {
   DASHBOARD_ICON_TEAMS,
 } DashboardIcon;
 
-static void parse_overview_data(const char *data) {
-  if (!data) {
-    return;
+static void update_loading_layer(void);
+
+// Build the overview cell's text once per overview or settings change, so the
+// loading animation and scrolling never reformat it
+static void format_overview_text(void) {
+  if (s_race_round == 0) {
+    snprintf(s_round_text, sizeof(s_round_text), "Season complete");
+    s_datetime_text[0] = '\0';
+  } else {
+    snprintf(s_round_text, sizeof(s_round_text), "Round %d", s_race_round);
+    utils_format_datetime_preferred(s_race_time, s_datetime_text, sizeof(s_datetime_text));
   }
 
-  const char *pipe1 = strchr(data, '|');
-  if (!pipe1) {
-    return;
-  }
+  s_time_format_signature = utils_time_format_signature();
+}
 
-  const char *pipe2 = strchr(pipe1 + 1, '|');
-  if (!pipe2) {
-    return;
+// Returns false if the payload is not a usable overview
+static bool parse_overview_data(const uint8_t *data, size_t length) {
+  WireReader reader;
+  int record_count = 0;
+  if (!wire_reader_init(&reader, data, length, WIRE_SCHEMA_OVERVIEW, &record_count)) {
+    return false;
   }
 
-  char round_str[16] = {0};
-  size_t round_len = pipe1 - data;
-  if (round_len >= sizeof(round_str)) {
-    round_len = sizeof(round_str) - 1;
-  }
-  strncpy(round_str, data, round_len);
-  round_str[round_len] = '\0';
+  // Single record: round, race name, race start time. No record means no
+  // race is left this season.
+  if (record_count < 1) {
+    s_race_round = 0;
+    snprintf(s_race_name, sizeof(s_race_name), "No upcoming race");
+    s_race_time = 0;
+  } else {
+    int round = wire_read_u8(&reader);
+    WireString name = wire_read_string(&reader);
+    uint32_t start_time = wire_read_u32(&reader);
+    if (reader.error) {
+      return false;
+    }
 
-  size_t name_len = pipe2 - pipe1 - 1;
-  if (name_len >= sizeof(s_race_name)) {
-    name_len = sizeof(s_race_name) - 1;
+    s_race_round = round;
+    wire_string_copy(name, s_race_name, sizeof(s_race_name));
+    s_race_time = (time_t)start_time;
   }
-  strncpy(s_race_name, pipe1 + 1, name_len);
-  s_race_name[name_len] = '\0';
-
-  strncpy(s_race_datetime, pipe2 + 1, sizeof(s_race_datetime) - 1);
-  s_race_datetime[sizeof(s_race_datetime) - 1] = '\0';
-
-  s_race_round = atoi(round_str);
   s_overview_loaded = true;
+  format_overview_text();
 
   APP_LOG(APP_LOG_LEVEL_INFO, "Parsed dashboard overview: round %d, %s",
           s_race_round, s_race_name);
-}
 
-static void dashboard_overview_received(const char *overview_text) {
-  parse_overview_data(overview_text);
+  // The overview's race is where the user most likely goes next
+  prefetch_schedule(s_race_round);
+  return true;
+}
 
-  if (s_overview_retry_timer) {
-    app_timer_cancel(s_overview_retry_timer);
-    s_overview_retry_timer = NULL;
+// Returns false if no usable overview is cached
+static bool load_cached_overview(void) {
+  size_t length = 0;
+  uint8_t *cached = dataset_cache_read(DATASET_OVERVIEW, 0, &length, NULL);
+  if (!cached) {
+    return false;
   }
-  if (s_loading_timer) {
-    app_timer_cancel(s_loading_timer);
-    s_loading_timer = NULL;
+  bool loaded = parse_overview_data(cached, length);
+  free(cached);
+  return loaded;
+}
+
+// Overview routed to us by the message handler
+static void overview_payload_received(const MessagePayload *payload, void *context) {
+  if (!parse_overview_data(payload->data, payload->length)) {
+    return;
   }
+  s_overview_live = true;
 
   if (s_menu_layer) {
+    update_loading_layer();
     menu_layer_reload_data(s_menu_layer);
   }
 }
 
+static void draw_loading_dot(GContext *ctx, int x, int y, bool active) {
+  const char *dot = ".";
+  const int dot_width = 10;
+  const int dot_height = 14;
+  GRect dot_rect = GRect(x - dot_width / 2, y - dot_height / 2 - (active ? 2 : 0),
+                         dot_width, dot_height);
+  graphics_draw_text(ctx, dot,
+                     DASHBOARD_HEADER_SUBTITLE_FONT,
+                     dot_rect,
+                     GTextOverflowModeWordWrap,
+                     GTextAlignmentCenter,
+                     NULL);
+}
+
+// The dots live in their own small layer over the overview cell, so each
+// animation frame only marks that layer dirty instead of reloading the menu
+static void loading_layer_update_proc(Layer *layer, GContext *ctx) {
+  GRect bounds = layer_get_bounds(layer);
+  const int center_x = bounds.size.w / 2;
+  const int center_y = bounds.size.h / 2 + 1;
+
+  // Only shown while the overview cell is selected
+  graphics_context_set_text_color(ctx, TEXT_COLOR_SELECTED);
+  for (int i = 0; i < 3; i++) {
+    draw_loading_dot(ctx, center_x - 8 + (i * 8), center_y, i == s_loading_phase);
+  }
+}
+
 static void loading_animation_tick(void *context) {
   s_loading_timer = NULL;
 
-  if (s_overview_loaded || !s_menu_layer) {
+  if (s_overview_loaded || !s_loading_layer || !s_app_focused ||
+      !s_window_visible) {
     return;
   }
 
   s_loading_phase = (s_loading_phase + 1) % 3;
-  menu_layer_reload_data(s_menu_layer);
+  layer_mark_dirty(s_loading_layer);
   s_loading_timer = app_timer_register(DASHBOARD_LOADING_ANIM_MS,
                                        loading_animation_tick, NULL);
 }
 
-static void request_overview_retry(void *context) {
-  s_overview_retry_timer = NULL;
+static void start_loading_animation(void) {
+  if (s_loading_timer || s_overview_loaded || !s_loading_layer ||
+      !s_app_focused || !s_window_visible) {
+    return;
+  }
 
-  if (!s_overview_loaded) {
-    APP_LOG(APP_LOG_LEVEL_INFO, "Retrying dashboard overview request");
-    message_handler_request_overview();
+  s_loading_timer = app_timer_register(DASHBOARD_LOADING_ANIM_MS,
+                                       loading_animation_tick, NULL);
+}
+
+static void stop_loading_animation(void) {
+  if (s_loading_timer) {
+    app_timer_cancel(s_loading_timer);
+    s_loading_timer = NULL;
   }
 }
 
-static void start_loading_animation(void) {
-  if (s_loading_timer || s_overview_loaded || !s_menu_layer) {
+static void update_loading_layer(void) {
+  if (!s_loading_layer) {
     return;
   }
 
-  s_loading_phase = 0;
-  s_loading_timer = app_timer_register(DASHBOARD_LOADING_ANIM_MS,
-                                       loading_animation_tick, NULL);
+  MenuIndex selected = menu_layer_get_selected_index(s_menu_layer);
+  bool visible = !s_overview_loaded && selected.row == 0;
+  layer_set_hidden(s_loading_layer, !visible);
+
+  // Keep the dots drawn but still while the app or the window is covered
+  if (visible && s_app_focused && s_window_visible) {
+    start_loading_animation();
+  } else {
+    stop_loading_animation();
+  }
 }
 
-static void draw_loading_dot(GContext *ctx, int x, int y, bool active) {
-  const char *dot = ".";
-  const int dot_width = 10;
-  const int dot_height = 14;
-  GRect dot_rect = GRect(x - dot_width / 2, y - dot_height / 2 - (active ? 2 : 0),
-                         dot_width, dot_height);
-  graphics_draw_text(ctx, dot,
-                     DASHBOARD_HEADER_SUBTITLE_FONT,
-                     dot_rect,
-                     GTextOverflowModeWordWrap,
-                     GTextAlignmentCenter,
-                     NULL);
+// Pause the animation while a notification or other modal covers the app
+static void app_focus_changed(bool in_focus) {
+  s_app_focused = in_focus;
+  update_loading_layer();
 }
 
 static uint16_t get_num_rows_callback(MenuLayer *menu_layer,
@@ -174,28 +243,13 @@ static void draw_overview_row(GContext *ctx, const Layer *cell_layer,
   graphics_context_set_text_color(ctx,
                                   selected ? TEXT_COLOR_SELECTED : TEXT_COLOR_UNSELECTED);
 
+  // The loading dots are drawn by s_loading_layer on top of this cell
   if (!s_overview_loaded) {
-    const int center_x = bounds.size.w / 2;
-    const int center_y = bounds.size.h / 2 + 1;
-    const int phase = s_loading_phase;
-
-    for (int i = 0; i < 3; i++) {
-      draw_loading_dot(ctx, center_x - 8 + (i * 8), center_y, i == phase);
-    }
     return;
   }
 
-  char round_text[20];
-  snprintf(round_text, sizeof(round_text), "Round %d", s_race_round);
-
-  char datetime_text[64];
-  utils_format_datetime_preferred(s_race_datetime, datetime_text, sizeof(datetime_text));
-  if (datetime_text[0] == '\0') {
-    snprintf(datetime_text, sizeof(datetime_text), "%s", s_race_datetime);
-  }
-
   GRect round_rect = GRect(H_INSET, 4, bounds.size.w - 2 * H_INSET, 16);
-  graphics_draw_text(ctx, round_text,
+  graphics_draw_text(ctx, s_round_text,
                      DASHBOARD_HEADER_SUBTITLE_FONT,
                      round_rect,
                      GTextOverflowModeTrailingEllipsis,
@@ -211,7 +265,7 @@ static void draw_overview_row(GContext *ctx, const Layer *cell_layer,
                      NULL);
 
   GRect datetime_rect = GRect(H_INSET, 44, bounds.size.w - 2 * H_INSET, 18);
-  graphics_draw_text(ctx, datetime_text,
+  graphics_draw_text(ctx, s_datetime_text,
                      DASHBOARD_HEADER_SUBTITLE_FONT,
                      datetime_rect,
                      GTextOverflowModeTrailingEllipsis,
@@ -299,11 +353,17 @@ static void draw_row_callback(GContext *ctx, const Layer *cell_layer,
   }
 }
 
+static void selection_changed_callback(struct MenuLayer *menu_layer,
+                                       MenuIndex new_index, MenuIndex old_index,
+                                       void *context) {
+  update_loading_layer();
+}
+
 static void select_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index,
                             void *context) {
   switch (cell_index->row) {
   case 0:
-    if (s_overview_loaded) {
+    if (s_overview_loaded && s_race_round > 0) {
       APP_LOG(APP_LOG_LEVEL_INFO, "Opening race window for round %d", s_race_round);
       race_window_push(s_race_round, s_race_name);
     }
@@ -342,28 +402,68 @@ static void window_load(Window *window) {
                                .get_header_height = flashback_screen_header_height_callback,
                                .get_cell_height = get_cell_height_callback,
                                .select_click = select_callback,
+                               .selection_changed = selection_changed_callback,
   });
 
-  snprintf(s_subtitle_text, sizeof(s_subtitle_text), "%d", g_current_season);
-  message_handler_set_overview_message_callback(dashboard_overview_received);
+  // Centre the loading dots over the overview cell, which sits below the
+  // header at the top, or in the middle of the screen on round displays
+  GRect bounds = layer_get_bounds(window_get_root_layer(window));
+  const int cell_y = PBL_IF_ROUND_ELSE((bounds.size.h - DASHBOARD_OVERVIEW_HEIGHT) / 2,
+                                       MENU_HEADER_HEIGHT);
+  s_loading_layer = layer_create(GRect((bounds.size.w - DASHBOARD_LOADING_WIDTH) / 2,
+                                       cell_y + (DASHBOARD_OVERVIEW_HEIGHT - DASHBOARD_LOADING_HEIGHT) / 2,
+                                       DASHBOARD_LOADING_WIDTH, DASHBOARD_LOADING_HEIGHT));
+  layer_set_update_proc(s_loading_layer, loading_layer_update_proc);
+  layer_add_child(window_get_root_layer(window), s_loading_layer);
+
+  app_focus_service_subscribe_handlers((AppFocusHandlers){
+      .did_focus = app_focus_changed,
+  });
 
-  if (!s_overview_loaded) {
+  snprintf(s_subtitle_text, sizeof(s_subtitle_text), "%d", g_current_season);
+  message_handler_subscribe(REQUEST_TYPE_GET_OVERVIEW,
+                            overview_payload_received, NULL);
+
+  // Show the last known overview straight away and revalidate it below
+  // unless it already arrived this session and is still held
+  s_overview_live = load_cached_overview() &&
+                    dataset_cache_is_fresh(DATASET_OVERVIEW, 0);
+  if (!s_overview_live) {
     message_handler_request_overview();
-    if (!s_overview_retry_timer) {
-      s_overview_retry_timer = app_timer_register(500, request_overview_retry, NULL);
-    }
-    start_loading_animation();
   }
+
+  update_loading_layer();
 }
 
 static void window_unload(Window *window) {
+  message_handler_unsubscribe(REQUEST_TYPE_GET_OVERVIEW,
+                              overview_payload_received);
+  app_focus_service_unsubscribe();
+  stop_loading_animation();
+  layer_destroy(s_loading_layer);
+  s_loading_layer = NULL;
   menu_layer_destroy(s_menu_layer);
   s_menu_layer = NULL;
   flashback_screen_destroy_header_background();
+  s_overview_live = false;
 }
 
 static void window_appear(Window *window) {
   snprintf(s_subtitle_text, sizeof(s_subtitle_text), "%d", g_current_season);
+  s_window_visible = true;
+  update_loading_layer();
+
+  // The watch may have changed timezone or clock style while we were away
+  if (s_overview_loaded && s_time_format_signature != utils_time_format_signature()) {
+    format_overview_text();
+    menu_layer_reload_data(s_menu_layer);
+  }
+}
+
+// Other windows pushed on top hide the dots, so stop animating them
+static void window_disappear(Window *window) {
+  s_window_visible = false;
+  stop_loading_animation();
 }
 
 void dashboard_window_push(void) {
@@ -373,6 +473,7 @@ void dashboard_window_push(void) {
                                              .load = window_load,
                                              .unload = window_unload,
                                              .appear = window_appear,
+                                             .disappear = window_disappear,
                                          });
   }
 
@@ -386,16 +487,11 @@ void dashboard_window_destroy(void) {
   }
 
   s_overview_loaded = false;
+  s_overview_live = false;
   s_race_round = 0;
   s_race_name[0] = '\0';
-  s_race_datetime[0] = '\0';
-  if (s_overview_retry_timer) {
-    app_timer_cancel(s_overview_retry_timer);
-    s_overview_retry_timer = NULL;
-  }
-  if (s_loading_timer) {
-    app_timer_cancel(s_loading_timer);
-    s_loading_timer = NULL;
-  }
-  message_handler_set_overview_message_callback(NULL);
+  s_race_time = 0;
+  s_round_text[0] = '\0';
+  s_datetime_text[0] = '\0';
+  stop_loading_animation();
 }
@@ -122,6 +122,23 @@ void flashback_screen_draw_header(GContext *ctx, const Layer *cell_layer,
   }
 }
 
+void flashback_screen_draw_section_title(GContext *ctx, GRect rect,
+                                         const char *title) {
+  graphics_context_set_fill_color(ctx, HEADER_COLOR);
+  graphics_fill_rect(ctx, rect, 0, GCornerNone);
+  graphics_context_set_text_color(ctx, HEADER_CONTENT_COLOR);
+
+  // Gothic sits low in its line box, so lift it to centre in the strip
+  GRect text_rect = GRect(rect.origin.x + H_INSET, rect.origin.y - 2,
+                          rect.size.w - 2 * H_INSET, rect.size.h);
+  graphics_draw_text(ctx, title,
+                    MENU_HEADER_TITLE_FONT,
+                    text_rect,
+                    GTextOverflowModeTrailingEllipsis,
+                    GTextAlignmentLeft,
+                    NULL);
+}
+
 int16_t flashback_screen_cell_height_callback(struct MenuLayer *menu_layer,
                                               MenuIndex *cell_index,
                                               void *context) {
@@ -17,6 +17,11 @@ void flashback_screen_draw_header(GContext *ctx, const Layer *cell_layer,
                                   const char *subtitle_left,
                                   const char *subtitle_right);
 
+// Draws a section title strip filling rect, for menus with more than one
+// section.
+void flashback_screen_draw_section_title(GContext *ctx, GRect rect,
+                                         const char *title);
+
 // Standard MenuLayer callbacks that screens can reference directly in a
 // MenuLayerCallbacks struct when they don't need custom behaviour.
 int16_t flashback_screen_cell_height_callback(struct MenuLayer *menu_layer,
@@ -0,0 +1,460 @@
+#include "list_window.h"
+#include "flashback_screen.h"
+#include "../colors.h"
+#include "../record_buffer.h"
+#include "../ui_constants.h"
+#include "../data_models.h"
+#include "../utils.h"
+#include <pebble.h>
+
+// Records parsed per slice. The first slice is parsed at once so a screenful
+// shows straight away; the rest follow on later timer ticks, leaving button
+// presses and redraws to be handled in between.
+#define PARSE_SLICE_RECORDS 8
+
+typedef enum {
+  LIST_COLUMN_POSITION = 0,
+  LIST_COLUMN_PRIMARY,
+  LIST_COLUMN_SECONDARY,
+  LIST_COLUMN_COUNT
+} ListColumnSlot;
+
+struct ListWindow {
+  const ListWindowSpec *spec;
+  Window *window;
+  MenuLayer *menu_layer;
+  char title[32];
+  char subtitle[16];
+
+  // Records of the current round
+  void *records;
+  int capacity;
+  int count;
+  StringArena arena;
+  int round;
+  bool data_loaded;
+  bool data_live;
+  // Chunk expected next of the transfer being shown, or 0 if none is
+  int next_chunk;
+
+  // Payload still being parsed, and whether to focus the split once it is
+  WireParseJob parse_job;
+  AppTimer *parse_timer;
+  bool focus_pending;
+
+  // First record of the second section, and the day it was worked out on
+  int split;
+  int split_day;
+  bool focused;
+
+  // Resolved once per load rather than on every row draw
+  const ListColumn *columns[LIST_COLUMN_COUNT];
+  GRect column_rects[LIST_COLUMN_COUNT];
+  GFont column_fonts[LIST_COLUMN_COUNT];
+};
+
+static void *record_at(const ListWindow *list, int index) {
+  return (uint8_t *)list->records + index * list->spec->record_size;
+}
+
+static bool has_sections(const ListWindow *list) {
+  return list->spec->split && list->split > 0 && list->split < list->count;
+}
+
+// Record shown at a menu index
+static int record_index(const ListWindow *list, const MenuIndex *index) {
+  return index->section > 0 ? list->split + index->row : index->row;
+}
+
+static void update_split(ListWindow *list) {
+  if (list->spec->split) {
+    list->split = list->spec->split(list->records, list->count);
+    list->split_day = utils_local_day(time(NULL));
+  }
+}
+
+// Centre the first record after the split, or the last one if every record
+// comes before it. Done once per load so a refresh never moves the user.
+static void focus_split(ListWindow *list) {
+  if (list->focused || !list->menu_layer || !list->spec->split ||
+      list->count == 0) {
+    return;
+  }
+
+  int index = list->split < list->count ? list->split : list->count - 1;
+  MenuIndex menu_index = has_sections(list)
+                             ? MenuIndex(1, index - list->split)
+                             : MenuIndex(0, index);
+  menu_layer_set_selected_index(list->menu_layer, menu_index,
+                                MenuRowAlignCenter, false);
+  list->focused = true;
+}
+
+static void read_record(WireReader *reader, int index, void *context) {
+  ListWindow *list = context;
+  list->spec->read_record(reader, record_at(list, index), &list->arena);
+}
+
+static void parse_timer_callback(void *context);
+
+// Parse the next slice of the payload and show the rows parsed so far
+static void continue_parse(ListWindow *list) {
+  list->count = wire_parse_job_step(&list->parse_job, PARSE_SLICE_RECORDS,
+                                    read_record, list);
+  list->data_loaded = true;
+  update_split(list);
+
+  bool done = wire_parse_job_done(&list->parse_job);
+  if (done) {
+    APP_LOG(APP_LOG_LEVEL_INFO, "Parsed %d records of schema %d", list->count,
+            list->spec->schema);
+  } else {
+    list->parse_timer = app_timer_register(0, parse_timer_callback, list);
+  }
+
+  if (list->menu_layer) {
+    menu_layer_reload_data(list->menu_layer);
+    if (done && list->focus_pending) {
+      focus_split(list);
+      list->focus_pending = false;
+    }
+  }
+}
+
+static void parse_timer_callback(void *context) {
+  ListWindow *list = context;
+  list->parse_timer = NULL;
+  continue_parse(list);
+}
+
+// Stop parsing in slices. finish parses the rest at once, so a following
+// chunk can append after the rows it announced.
+static void stop_parse(ListWindow *list, bool finish) {
+  if (list->parse_timer) {
+    app_timer_cancel(list->parse_timer);
+    list->parse_timer = NULL;
+  }
+  if (finish && !wire_parse_job_done(&list->parse_job)) {
+    list->count = wire_parse_job_step(&list->parse_job, 0, read_record, list);
+  }
+  wire_parse_job_cancel(&list->parse_job);
+}
+
+// Parse data, a heap buffer this takes ownership of. append continues after
+// the rows of an earlier chunk; complete means no chunks follow, so the split
+// can be focused once every row is in.
+static void parse_data(ListWindow *list, uint8_t *data, size_t length,
+                       bool append, bool complete) {
+  const ListWindowSpec *spec = list->spec;
+  stop_parse(list, append);
+
+  int first_index = append ? list->count : 0;
+  if (first_index == 0) {
+    string_arena_reset(&list->arena);
+  }
+
+  // Grow the rows to the count this payload announces
+  int count = wire_record_count(data, length, spec->schema);
+  if (count < 0 ||
+      !record_buffer_reserve(&list->records, &list->capacity,
+                             first_index + count, spec->record_size) ||
+      (spec->has_strings && !string_arena_reserve(&list->arena, length))) {
+    free(data);
+    return;
+  }
+
+  if (wire_parse_job_start(&list->parse_job, data, length, spec->schema,
+                           first_index, list->capacity)) {
+    list->focus_pending = complete;
+    continue_parse(list);
+  }
+}
+
+// Returns false if nothing is cached for the round
+static bool load_cached_data(ListWindow *list) {
+  size_t length = 0;
+  uint8_t *cached = dataset_cache_read(list->spec->dataset, list->round, &length, NULL);
+  if (!cached) {
+    return false;
+  }
+  parse_data(list, cached, length, false, true);
+  return true;
+}
+
+// Rows only live while the window is loaded; the cache keeps them otherwise
+static void release_data(ListWindow *list) {
+  stop_parse(list, false);
+  record_buffer_free(&list->records, &list->capacity);
+  string_arena_destroy(&list->arena);
+  list->count = 0;
+  list->data_loaded = false;
+  list->next_chunk = 0;
+}
+
+// Dataset routed to us by the message handler
+static void payload_received(const MessagePayload *payload, void *context) {
+  ListWindow *list = context;
+
+  // Ignore a late reply for a round we have since navigated away from
+  if (list->spec->per_round && payload->round != list->round) {
+    return;
+  }
+
+  // Opened mid-transfer, the window missed the chunks before this one. The
+  // message handler caches the whole payload before the last chunk arrives
+  // here, so take it from the cache then.
+  bool complete = message_payload_is_complete(payload);
+  if (payload->chunk_index > 0 && payload->chunk_index != list->next_chunk) {
+    if (complete) {
+      list->data_live = load_cached_data(list) &&
+                        dataset_cache_is_fresh(list->spec->dataset, list->round);
+    }
+    return;
+  }
+  list->next_chunk = complete ? 0 : payload->chunk_index + 1;
+
+  // The payload only lives for this callback, but parsing it can run on
+  uint8_t *data = malloc(payload->length);
+  if (!data) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Failed to copy payload of %d bytes",
+            (int)payload->length);
+    return;
+  }
+  memcpy(data, payload->data, payload->length);
+
+  // Later chunks of a transfer append to the rows already parsed
+  list->data_live = complete;
+  parse_data(list, data, payload->length, payload->chunk_index > 0, complete);
+}
+
+// Work out where each column sits in a row of the given width
+static void layout_columns(ListWindow *list, int16_t width) {
+  const ListWindowSpec *spec = list->spec;
+  const int16_t height = MENU_CELL_HEIGHT - 4;
+  const int16_t secondary_width = spec->secondary.text ? spec->secondary.width : 0;
+  const int16_t primary_x = spec->position.text
+                                ? H_INSET + MENU_ROW_POS_WIDTH + MENU_ROW_POS_GAP
+                                : H_INSET;
+
+  list->columns[LIST_COLUMN_POSITION] = &spec->position;
+  list->columns[LIST_COLUMN_PRIMARY] = &spec->primary;
+  list->columns[LIST_COLUMN_SECONDARY] = &spec->secondary;
+
+  list->column_rects[LIST_COLUMN_POSITION] =
+      GRect(H_INSET, 2, MENU_ROW_POS_WIDTH, height);
+  list->column_rects[LIST_COLUMN_PRIMARY] =
+      GRect(primary_x, 2, width - primary_x - secondary_width - H_INSET, height);
+  list->column_rects[LIST_COLUMN_SECONDARY] =
+      GRect(width - secondary_width - H_INSET, spec->secondary.small_font ? 4 : 2,
+            secondary_width, height);
+
+  for (int i = 0; i < LIST_COLUMN_COUNT; i++) {
+    list->column_fonts[i] = list->columns[i]->small_font
+                                ? LIST_WINDOW_SECONDARY_FONT
+                                : LIST_WINDOW_ROW_FONT;
+  }
+}
+
+// Menu layer callbacks
+static uint16_t get_num_sections_callback(struct MenuLayer *menu_layer,
+                                          void *context) {
+  return has_sections(context) ? 2 : 1;
+}
+
+static uint16_t get_num_rows_callback(MenuLayer *menu_layer,
+                                      uint16_t section_index, void *context) {
+  ListWindow *list = context;
+  if (!list->data_loaded) {
+    return 1; // Show loading
+  }
+  if (has_sections(list)) {
+    return section_index == 0 ? list->split : list->count - list->split;
+  }
+  return list->count > 0 ? list->count : 1;
+}
+
+static void draw_row_callback(GContext *ctx, const Layer *cell_layer,
+                              MenuIndex *cell_index, void *context) {
+  ListWindow *list = context;
+
+  if (!list->data_loaded) {
+    menu_cell_basic_draw(ctx, cell_layer, "Loading...", NULL, NULL);
+    return;
+  }
+
+  int index = record_index(list, cell_index);
+  if (index >= list->count) {
+    menu_cell_basic_draw(ctx, cell_layer, list->spec->empty_text, NULL, NULL);
+    return;
+  }
+
+  const void *record = record_at(list, index);
+  bool selected = menu_layer_is_index_selected(list->menu_layer, cell_index);
+
+  if (selected) {
+    graphics_context_set_fill_color(ctx, HIGHLIGHT_BG);
+    graphics_fill_rect(ctx, layer_get_bounds(cell_layer), 0, GCornerNone);
+  }
+
+  graphics_context_set_text_color(ctx, selected ? TEXT_COLOR_SELECTED
+                                                : TEXT_COLOR_UNSELECTED);
+
+  for (int i = 0; i < LIST_COLUMN_COUNT; i++) {
+    const ListColumn *column = list->columns[i];
+    if (!column->text) {
+      continue;
+    }
+    graphics_draw_text(ctx, column->text(record, &list->arena),
+                      list->column_fonts[i],
+                      list->column_rects[i],
+                      GTextOverflowModeTrailingEllipsis,
+                      i == LIST_COLUMN_SECONDARY ? GTextAlignmentRight
+                                                 : GTextAlignmentLeft,
+                      NULL);
+  }
+}
+
+static void select_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index,
+                            void *context) {
+  ListWindow *list = context;
+  int index = record_index(list, cell_index);
+  if (list->spec->select && list->data_loaded && index < list->count) {
+    list->spec->select(record_at(list, index), &list->arena);
+  }
+}
+
+// With sections, the first header also carries the screen header above its
+// section title
+static void draw_header_callback(GContext *ctx, const Layer *cell_layer,
+                                 uint16_t section_index, void *context) {
+  ListWindow *list = context;
+  GRect bounds = layer_get_bounds(cell_layer);
+
+  if (section_index == 0) {
+    flashback_screen_draw_header(ctx, cell_layer, list->title, list->subtitle);
+    if (!has_sections(list)) {
+      return;
+    }
+    bounds.origin.y = MENU_HEADER_HEIGHT;
+    bounds.size.h = MENU_SECTION_HEADER_HEIGHT;
+  }
+
+  flashback_screen_draw_section_title(ctx, bounds,
+                                      list->spec->section_titles[section_index]);
+}
+
+static int16_t get_header_height_callback(struct MenuLayer *menu_layer,
+                                          uint16_t section_index,
+                                          void *context) {
+  if (section_index > 0) {
+    return MENU_SECTION_HEADER_HEIGHT;
+  }
+  return has_sections(context) ? MENU_HEADER_HEIGHT + MENU_SECTION_HEADER_HEIGHT
+                               : MENU_HEADER_HEIGHT;
+}
+
+// Window lifecycle
+static void window_load(Window *window) {
+  ListWindow *list = window_get_user_data(window);
+  list->menu_layer = flashback_screen_create_menu_layer(window);
+  layout_columns(list, layer_get_bounds(menu_layer_get_layer(list->menu_layer)).size.w);
+
+  menu_layer_set_callbacks(list->menu_layer, list,
+                           (MenuLayerCallbacks){
+                               .get_num_sections = get_num_sections_callback,
+                               .get_num_rows = get_num_rows_callback,
+                               .draw_row = draw_row_callback,
+                               .select_click = select_callback,
+                               .draw_header = draw_header_callback,
+                               .get_header_height = get_header_height_callback,
+                               .get_cell_height = flashback_screen_cell_height_callback,
+                           });
+
+  message_handler_subscribe(list->spec->request_type, payload_received, list);
+
+  // Render the cached rows immediately, then revalidate them from the phone
+  // unless they already arrived this session and are still held
+  list->focused = false;
+  list->data_live = load_cached_data(list) &&
+                    dataset_cache_is_fresh(list->spec->dataset, list->round);
+  if (!list->data_live) {
+    list->spec->request(list->round);
+  }
+}
+
+static void window_unload(Window *window) {
+  ListWindow *list = window_get_user_data(window);
+  message_handler_unsubscribe(list->spec->request_type, payload_received);
+  menu_layer_destroy(list->menu_layer);
+  list->menu_layer = NULL;
+  flashback_screen_destroy_header_background();
+  release_data(list);
+  list->data_live = false;
+}
+
+static void window_appear(Window *window) {
+  ListWindow *list = window_get_user_data(window);
+  snprintf(list->subtitle, sizeof(list->subtitle), "%d", g_current_season);
+
+  // Sections split on the date move over to the next day at midnight
+  if (list->spec->split && list->data_loaded &&
+      list->split_day != utils_local_day(time(NULL))) {
+    update_split(list);
+    menu_layer_reload_data(list->menu_layer);
+  }
+}
+
+ListWindow *list_window_create(const ListWindowSpec *spec) {
+  ListWindow *list = malloc(sizeof(ListWindow));
+  if (!list) {
+    return NULL;
+  }
+  memset(list, 0, sizeof(ListWindow));
+  list->spec = spec;
+  list->round = -1;
+
+  list->window = window_create();
+  window_set_user_data(list->window, list);
+  window_set_window_handlers(list->window, (WindowHandlers){
+                                               .load = window_load,
+                                               .unload = window_unload,
+                                               .appear = window_appear,
+                                           });
+  return list;
+}
+
+void list_window_destroy(ListWindow *list) {
+  if (!list) {
+    return;
+  }
+  window_destroy(list->window);
+  release_data(list);
+  free(list);
+}
+
+void list_window_set_title(ListWindow *list, const char *title) {
+  snprintf(list->title, sizeof(list->title), "%s", title);
+}
+
+void list_window_push(ListWindow *list, int round) {
+  if (round != list->round) {
+    // Clear the other round's rows to prevent showing stale data
+    list->round = round;
+    release_data(list);
+    list->data_live = false;
+
+    // Already on screen: show the new round's rows and revalidate them
+    // unless they are current
+    if (list->menu_layer) {
+      list->focused = false;
+      list->data_live = load_cached_data(list) &&
+                        dataset_cache_is_fresh(list->spec->dataset, list->round);
+      menu_layer_reload_data(list->menu_layer);
+      if (!list->data_live) {
+        list->spec->request(list->round);
+      }
+    }
+  }
+
+  window_stack_push(list->window, true);
+}
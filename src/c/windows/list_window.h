@@ -0,0 +1,69 @@
+#pragma once
+
+#include "../dataset_cache.h"
+#include "../message_handler.h"
+#include "../string_arena.h"
+#include "../wire_format.h"
+#include <pebble.h>
+
+// A menu of one dataset's records drawn as up to three columns: a narrow
+// position column, the primary text, and an optional right-aligned secondary
+// column. Screens that only differ in their record layout and columns share
+// this window instead of each repeating the lifecycle, parser and draw code.
+
+// Text of a column for one record. arena holds the record's strings.
+typedef const char *(*ListColumnText)(const void *record,
+                                      const StringArena *arena);
+
+typedef struct {
+  ListColumnText text;
+  // Width of the secondary column; the primary column fills the rest
+  int16_t width;
+  // Draw in the smaller secondary font
+  bool small_font;
+} ListColumn;
+
+typedef struct {
+  // Where the records come from
+  RequestType request_type;
+  DatasetId dataset;
+  WireSchema schema;
+  size_t record_size;
+  // Datasets kept per race round rather than once per season
+  bool per_round;
+  // Records keep strings in the window's arena
+  bool has_strings;
+  // Read one record's fields into record
+  void (*read_record)(WireReader *reader, void *record, StringArena *arena);
+  void (*request)(int round);
+
+  // How they are drawn. A column with no text is left out.
+  ListColumn position;
+  ListColumn primary;
+  ListColumn secondary;
+  const char *empty_text;
+
+  // Optional: split the rows into two sections at the index split returns,
+  // e.g. past and upcoming races, and focus the first row after it. It is
+  // rerun for each payload and when the local day changes.
+  int (*split)(const void *records, int count);
+  const char *section_titles[2];
+
+  // Optional select handler
+  void (*select)(const void *record, const StringArena *arena);
+} ListWindowSpec;
+
+typedef struct ListWindow ListWindow;
+
+// Create a list window for spec, which must outlive it
+ListWindow *list_window_create(const ListWindowSpec *spec);
+
+// Destroy the window and release its records
+void list_window_destroy(ListWindow *list);
+
+// Header text shown left of the season
+void list_window_set_title(ListWindow *list, const char *title);
+
+// Show the records of round (0 for season-wide datasets), dropping the rows
+// of any other round the window still holds
+void list_window_push(ListWindow *list, int round);
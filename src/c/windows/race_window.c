@@ -3,13 +3,16 @@
 #include "results_qualifying_window.h"
 #include "flashback_screen.h"
 #include "../data_models.h"
+#include "../dataset_cache.h"
 #include "../message_handler.h"
+#include "../prefetch.h"
+#include "../record_buffer.h"
+#include "../wire_format.h"
 #include "../utils.h"
 #include "../colors.h"
 #include "../ui_constants.h"
 #include <pebble.h>
 
-#define MAX_EVENTS 10
 // Width of the fixed event-code column (fits up to 3 chars e.g. "FP1")
 #define EVENT_CODE_WIDTH 40
 
@@ -18,107 +21,174 @@ static MenuLayer *s_menu_layer;
 static char s_subtitle_text[16];
 
 // Event data storage
-static RaceEvent s_events[MAX_EVENTS];
+static RaceEvent *s_events;
+static int s_event_capacity = 0;
+static StringArena s_arena;
 static int s_event_count = 0;
 static bool s_data_loaded = false;
+static bool s_data_live = false;
+// Chunk expected next of the transfer being shown, or 0 if none is
+static int s_next_chunk = 0;
 static int s_current_race_index = -1;
 static char s_race_name[64] = "Race Schedule";
+static int32_t s_time_format_signature = 0;
 
-// Parse pipe-delimited event data
-static void parse_event_data(const char *data) {
-  if (!data) {
-    return;
-  }
-
-  // Reset event count
-  s_event_count = 0;
-
-  const char *ptr = data;
-  char line_buffer[256];
-
-  // Parse each line manually
-  while (*ptr && s_event_count < MAX_EVENTS) {
-    // Extract one line
-    size_t line_len = 0;
-    while (*ptr && *ptr != '\n' && line_len < sizeof(line_buffer) - 1) {
-      line_buffer[line_len++] = *ptr++;
-    }
-    line_buffer[line_len] = '\0';
-
-    // Skip the newline
-    if (*ptr == '\n') {
-      ptr++;
-    }
-
-    // Skip empty lines
-    if (line_len == 0) {
-      continue;
-    }
-
-    // Parse pipe-delimited fields: label|datetime
-    char label[64] = {0};
-    char datetime[64] = {0};
-
-    // Find pipe delimiter (label|datetime)
-    const char *pipe = strchr(line_buffer, '|');
-    if (!pipe) continue;
-
-    // Extract label
-    size_t label_len = pipe - line_buffer;
-    if (label_len >= sizeof(label)) label_len = sizeof(label) - 1;
-    strncpy(label, line_buffer, label_len);
-    label[label_len] = '\0';
+// Schedule record: session label, UTC start time
+static void read_event_record(WireReader *reader, int index, void *context) {
+  RaceEvent *event = &s_events[index];
+  event->label = wire_read_string_arena(reader, &s_arena);
+  event->start_time = wire_read_u32(reader);
+}
 
-    // Extract datetime (rest of the line)
-    strncpy(datetime, pipe + 1, sizeof(datetime) - 1);
-    datetime[sizeof(datetime) - 1] = '\0';
+// Build each row's local start time. Only redone when the data or the
+// 12/24h/timezone settings change, never per frame.
+static void format_event_times(void) {
+  for (int i = 0; i < s_event_count; i++) {
+    RaceEvent *event = &s_events[i];
+#if defined(PBL_PLATFORM_EMERY) || defined(PBL_PLATFORM_GABBRO)
+    utils_format_datetime_large(event->start_time, event->time_text, sizeof(event->time_text));
+#else
+    utils_format_datetime_compact(event->start_time, event->time_text, sizeof(event->time_text));
+#endif
+  }
+  s_time_format_signature = utils_time_format_signature();
+}
 
-    // Store the data
-    snprintf(s_events[s_event_count].label, sizeof(s_events[s_event_count].label), "%s", label);
-    snprintf(s_events[s_event_count].datetime, sizeof(s_events[s_event_count].datetime), "%s", datetime);
-    s_events[s_event_count].index = s_event_count;
+static void parse_event_data(const uint8_t *data, size_t length,
+                             int first_index) {
+  if (first_index == 0) {
+    string_arena_reset(&s_arena);
+  }
 
-    s_event_count++;
+  // Grow the rows to the count this payload announces
+  int count = wire_record_count(data, length, WIRE_SCHEMA_RACE_SCHEDULE);
+  if (count < 0 ||
+      !record_buffer_reserve((void **)&s_events, &s_event_capacity,
+                             first_index + count, sizeof(*s_events)) ||
+      !string_arena_reserve(&s_arena, length)) {
+    return;
   }
 
+  count = wire_parse_records(data, length, WIRE_SCHEMA_RACE_SCHEDULE, first_index,
+                             s_event_capacity, read_event_record, NULL);
+  s_event_count = count;
+  format_event_times();
   APP_LOG(APP_LOG_LEVEL_INFO, "Parsed %d events from data", s_event_count);
   s_data_loaded = true;
 }
 
-// Callbacks from message handler
-static void on_event_data_received(int index, const char *title,
-                                   const char *subtitle, const char *extra) {
-  // Legacy callback - not used with new format
+// Returns false if nothing is cached for the round
+static bool load_cached_data(void) {
+  size_t length = 0;
+  uint8_t *cached = dataset_cache_read(DATASET_RACE_DETAILS, s_current_race_index, &length, NULL);
+  if (!cached) {
+    return false;
+  }
+  parse_event_data(cached, length, 0);
+  free(cached);
+  return true;
 }
 
-static void on_event_count_received(int count) {
-  // Legacy callback - not used with new format
+// Rows only live while the window is loaded; the cache keeps them otherwise
+static void release_data(void) {
+  record_buffer_free((void **)&s_events, &s_event_capacity);
+  string_arena_destroy(&s_arena);
+  s_event_count = 0;
+  s_data_loaded = false;
+  s_next_chunk = 0;
 }
 
-// Custom inbox handler for race event text
-static void race_inbox_received(DictionaryIterator *iterator, void *context) {
-  Tuple *request_type_tuple = dict_find(iterator, MESSAGE_KEY_REQUEST_TYPE);
-  if (!request_type_tuple) {
+// One round of the cached calendar and whether the rounds either side exist,
+// found in a single pass over it
+typedef struct {
+  int round;
+  char *name;
+  size_t name_size;
+  bool found;
+  bool has_previous;
+  bool has_next;
+} CalendarLookup;
+
+// Calendar record: round, name, location, date
+static void read_calendar_record(WireReader *reader, int index, void *context) {
+  CalendarLookup *lookup = context;
+  int round = wire_read_u8(reader);
+  WireString name = wire_read_string(reader);
+  wire_read_string(reader);
+  wire_read_u32(reader);
+
+  if (reader->error) {
     return;
   }
+  if (round == lookup->round) {
+    if (lookup->name) {
+      wire_string_copy(name, lookup->name, lookup->name_size);
+    }
+    lookup->found = true;
+  } else if (round == lookup->round - 1) {
+    lookup->has_previous = true;
+  } else if (round == lookup->round + 1) {
+    lookup->has_next = true;
+  }
+}
 
-  int request_type = request_type_tuple->value->int32;
-  if (request_type != REQUEST_TYPE_GET_RACE_DETAILS) {
-    return;
+// Look up round in the season's calendar, copying its race name if name is
+// set. Rounds outside the cached calendar are treated as not existing.
+static CalendarLookup find_calendar_round(int round, char *name, size_t name_size) {
+  CalendarLookup lookup = {.round = round, .name = name, .name_size = name_size};
+  if (round <= 0) {
+    return lookup;
   }
 
-  // Get the formatted event text
-  Tuple *title_tuple = dict_find(iterator, MESSAGE_KEY_DATA_TITLE);
-  if (!title_tuple) {
-    APP_LOG(APP_LOG_LEVEL_ERROR, "No title in race details message");
-    return;
+  size_t length = 0;
+  uint8_t *cached = dataset_cache_read(DATASET_CALENDAR, 0, &length, NULL);
+  if (!cached) {
+    return lookup;
+  }
+
+  int count = wire_record_count(cached, length, WIRE_SCHEMA_CALENDAR);
+  if (count > 0) {
+    wire_parse_records(cached, length, WIRE_SCHEMA_CALENDAR, 0, count,
+                       read_calendar_record, &lookup);
   }
+  free(cached);
+  return lookup;
+}
+
+// Warm the cache with the rounds either side, so stepping to them is instant.
+// lookup is the current round's, or NULL to look it up.
+static void prefetch_neighbours(const CalendarLookup *lookup) {
+  CalendarLookup current;
+  if (!lookup) {
+    current = find_calendar_round(s_current_race_index, NULL, 0);
+    lookup = &current;
+  }
+  prefetch_race_neighbours(lookup->has_previous ? s_current_race_index - 1 : 0,
+                           lookup->has_next ? s_current_race_index + 1 : 0);
+}
 
-  const char *events_text = title_tuple->value->cstring;
-  APP_LOG(APP_LOG_LEVEL_INFO, "Received race events text (%d chars)", strlen(events_text));
+// Race schedule routed to us by the message handler
+static void schedule_payload_received(const MessagePayload *payload, void *context) {
+  // Ignore a late reply for a race we have since navigated away from
+  if (payload->round != s_current_race_index) {
+    return;
+  }
 
-  // Parse the pipe-delimited data
-  parse_event_data(events_text);
+  // Opened mid-transfer, the window missed the chunks before this one, so
+  // wait for the last and take the whole schedule the message handler cached
+  bool complete = message_payload_is_complete(payload);
+  if (payload->chunk_index > 0 && payload->chunk_index != s_next_chunk) {
+    if (complete) {
+      s_data_live = load_cached_data() &&
+                    dataset_cache_is_fresh(DATASET_RACE_DETAILS, s_current_race_index);
+    }
+  } else {
+    // Later chunks of a transfer append to the rows already parsed
+    int first_index = payload->chunk_index > 0 ? s_event_count : 0;
+    parse_event_data(payload->data, payload->length, first_index);
+    s_data_live = complete;
+    s_next_chunk = complete ? 0 : payload->chunk_index + 1;
+  }
 
   // Reload the menu
   if (s_menu_layer) {
@@ -162,7 +232,7 @@ static void draw_row_callback(GContext *ctx, const Layer *cell_layer,
 
     // Event shorthand code in fixed-width left column
     GRect code_rect = GRect(H_INSET, 2, EVENT_CODE_WIDTH, bounds.size.h - 4);
-    graphics_draw_text(ctx, event->label,
+    graphics_draw_text(ctx, string_arena_get(&s_arena, event->label),
                       RACE_WINDOW_ROW_FONT,
                       code_rect,
                       GTextOverflowModeTrailingEllipsis,
@@ -171,16 +241,12 @@ static void draw_row_callback(GContext *ctx, const Layer *cell_layer,
 
     // Compact date/time right-aligned
 #if defined(PBL_PLATFORM_EMERY) || defined(PBL_PLATFORM_GABBRO)
-    char compact_time[16];
-    utils_format_datetime_large(event->datetime, compact_time, sizeof(compact_time));
     const int time_width = 104;
 #else
-    char compact_time[13];
-    utils_format_datetime_compact(event->datetime, compact_time, sizeof(compact_time));
     const int time_width = 80;
 #endif
     GRect time_rect = GRect(bounds.size.w - time_width - H_INSET, 2, time_width, bounds.size.h - 4);
-    graphics_draw_text(ctx, compact_time,
+    graphics_draw_text(ctx, event->time_text,
                       RACE_WINDOW_ROW_FONT,
                       time_rect,
                       GTextOverflowModeTrailingEllipsis,
@@ -197,10 +263,7 @@ static void select_callback(struct MenuLayer *menu_layer, MenuIndex *cell_index,
     return;
   }
 
-  const char *label = s_events[cell_index->row].label;
-  if (!label) {
-    return;
-  }
+  const char *label = string_arena_get(&s_arena, s_events[cell_index->row].label);
 
   if (strcmp(label, "Race") == 0) {
     results_window_push(s_current_race_index);
@@ -214,6 +277,55 @@ static void draw_header_callback(GContext *ctx, const Layer *cell_layer,
   flashback_screen_draw_header(ctx, cell_layer, s_race_name, s_subtitle_text);
 }
 
+static void show_race(int race_index, const char *race_name,
+                      const CalendarLookup *lookup);
+
+// Step to the previous or next round of the calendar in place
+static void step_round(int step) {
+  char race_name[sizeof(s_race_name)];
+  int race_index = s_current_race_index + step;
+  CalendarLookup lookup = find_calendar_round(race_index, race_name, sizeof(race_name));
+  if (!lookup.found) {
+    vibes_short_pulse();
+    return;
+  }
+
+  show_race(race_index, race_name, &lookup);
+  menu_layer_set_selected_index(s_menu_layer, MenuIndex(0, 0), MenuRowAlignTop, false);
+}
+
+// The menu layer's own click config has no long presses, so scrolling and
+// select are rebuilt here next to the round stepping. A button with a long
+// press can't repeat, so holding up/down steps rounds instead of scrolling.
+static void up_click_handler(ClickRecognizerRef recognizer, void *context) {
+  menu_layer_set_selected_next(s_menu_layer, true, MenuRowAlignCenter, true);
+}
+
+static void down_click_handler(ClickRecognizerRef recognizer, void *context) {
+  menu_layer_set_selected_next(s_menu_layer, false, MenuRowAlignCenter, true);
+}
+
+static void select_click_handler(ClickRecognizerRef recognizer, void *context) {
+  MenuIndex index = menu_layer_get_selected_index(s_menu_layer);
+  select_callback(s_menu_layer, &index, NULL);
+}
+
+static void previous_race_handler(ClickRecognizerRef recognizer, void *context) {
+  step_round(-1);
+}
+
+static void next_race_handler(ClickRecognizerRef recognizer, void *context) {
+  step_round(1);
+}
+
+static void click_config_provider(void *context) {
+  window_single_click_subscribe(BUTTON_ID_UP, up_click_handler);
+  window_single_click_subscribe(BUTTON_ID_DOWN, down_click_handler);
+  window_single_click_subscribe(BUTTON_ID_SELECT, select_click_handler);
+  window_long_click_subscribe(BUTTON_ID_UP, 0, previous_race_handler, NULL);
+  window_long_click_subscribe(BUTTON_ID_DOWN, 0, next_race_handler, NULL);
+}
+
 // Window lifecycle
 static void window_load(Window *window) {
   s_menu_layer = flashback_screen_create_menu_layer(window);
@@ -228,51 +340,76 @@ static void window_load(Window *window) {
                                .draw_header = draw_header_callback,
                                .get_header_height = flashback_screen_header_height_callback,
                            });
+  window_set_click_config_provider(window, click_config_provider);
 
-  app_message_register_inbox_received(race_inbox_received);
+  message_handler_subscribe(REQUEST_TYPE_GET_RACE_DETAILS,
+                            schedule_payload_received, NULL);
 
-  if (s_current_race_index >= 0 && !s_data_loaded) {
-    message_handler_set_race_details_callbacks(on_event_data_received,
-                                               on_event_count_received);
-    message_handler_request_race_details(s_current_race_index);
+  // Render the cached schedule immediately, then revalidate it from the phone
+  // unless it already arrived this session and is still held
+  if (s_current_race_index >= 0) {
+    s_data_live = load_cached_data() &&
+                  dataset_cache_is_fresh(DATASET_RACE_DETAILS, s_current_race_index);
+  }
+
+  // Results and qualifying come along, so opening them from here is instant
+  if (s_current_race_index >= 0 && !s_data_live) {
+    message_handler_request_race_weekend(s_current_race_index);
+  }
+  if (s_current_race_index >= 0) {
+    prefetch_neighbours(NULL);
   }
 }
 
 static void window_unload(Window *window) {
+  message_handler_unsubscribe(REQUEST_TYPE_GET_RACE_DETAILS,
+                              schedule_payload_received);
   menu_layer_destroy(s_menu_layer);
   s_menu_layer = NULL;
   flashback_screen_destroy_header_background();
+  release_data();
+  s_data_live = false;
 }
 
-void race_window_push(int race_index, const char *race_name) {
-  // Check if this is a different race than the currently loaded one
-  bool is_different_race = (race_index != s_current_race_index);
+static void window_appear(Window *window) {
+  // The watch may have changed timezone or clock style while we were away
+  if (s_data_loaded && s_time_format_signature != utils_time_format_signature()) {
+    format_event_times();
+    menu_layer_reload_data(s_menu_layer);
+  }
+}
 
+// Switch to race_index, dropping the rows of the round shown before. If the
+// window is on screen the new round is loaded and requested unless current.
+// lookup is the new round's calendar lookup if the caller already made one.
+static void show_race(int race_index, const char *race_name,
+                      const CalendarLookup *lookup) {
   s_current_race_index = race_index;
+  release_data();
+  s_data_live = false;
 
-  // Only clear data if switching to a different race
-  if (is_different_race) {
-    s_data_loaded = false;
-    s_event_count = 0;
-
-    // Clear old event data to prevent showing stale data
-    memset(s_events, 0, sizeof(s_events));
-
-    // Store race name for header display
-    if (race_name) {
-      snprintf(s_race_name, sizeof(s_race_name), "%s", race_name);
-    } else {
-      snprintf(s_race_name, sizeof(s_race_name), "Race Schedule");
-    }
+  // Store race name for header display
+  if (race_name) {
+    snprintf(s_race_name, sizeof(s_race_name), "%s", race_name);
+  } else {
+    snprintf(s_race_name, sizeof(s_race_name), "Race Schedule");
+  }
 
-    // If window is already loaded, reload menu and request new data
-    if (s_menu_layer) {
-      menu_layer_reload_data(s_menu_layer);
-      // Request race details for the new race
-      message_handler_set_race_details_callbacks(on_event_data_received,
-                                                 on_event_count_received);
-      message_handler_request_race_details(s_current_race_index);
+  if (s_menu_layer) {
+    s_data_live = load_cached_data() &&
+                  dataset_cache_is_fresh(DATASET_RACE_DETAILS, s_current_race_index);
+    menu_layer_reload_data(s_menu_layer);
+    if (!s_data_live) {
+      message_handler_request_race_weekend(s_current_race_index);
     }
+    prefetch_neighbours(lookup);
+  }
+}
+
+void race_window_push(int race_index, const char *race_name) {
+  // Only clear data if switching to a different race
+  if (race_index != s_current_race_index) {
+    show_race(race_index, race_name, NULL);
   }
 
   snprintf(s_subtitle_text, sizeof(s_subtitle_text), "%d", g_current_season);
@@ -282,6 +419,7 @@ void race_window_push(int race_index, const char *race_name) {
     window_set_window_handlers(s_window, (WindowHandlers){
                                              .load = window_load,
                                              .unload = window_unload,
+                                             .appear = window_appear,
                                          });
   }
 
@@ -294,8 +432,8 @@ void race_window_destroy(void) {
     s_window = NULL;
   }
 
-  s_data_loaded = false;
-  s_event_count = 0;
+  release_data();
+  s_data_live = false;
   s_current_race_index = -1;
   s_subtitle_text[0] = '\0';
 }
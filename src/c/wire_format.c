@@ -0,0 +1,245 @@
+#include "wire_format.h"
+#include <pebble.h>
+
+bool wire_reader_init(WireReader *reader, const uint8_t *data, size_t length,
+                      WireSchema schema, int *record_count) {
+  if (!reader || !data || length < WIRE_HEADER_SIZE || data[0] != schema) {
+    return false;
+  }
+
+  reader->data = data;
+  reader->length = length;
+  reader->pos = WIRE_HEADER_SIZE;
+  reader->error = false;
+
+  if (record_count) {
+    *record_count = data[1];
+  }
+  return true;
+}
+
+int wire_record_count(const uint8_t *data, size_t length, WireSchema schema) {
+  WireReader reader;
+  int record_count = 0;
+  if (!wire_reader_init(&reader, data, length, schema, &record_count)) {
+    return -1;
+  }
+  return record_count;
+}
+
+uint8_t wire_read_u8(WireReader *reader) {
+  if (reader->pos + 1 > reader->length) {
+    reader->error = true;
+    return 0;
+  }
+
+  return reader->data[reader->pos++];
+}
+
+uint16_t wire_read_u16(WireReader *reader) {
+  if (reader->pos + 2 > reader->length) {
+    reader->error = true;
+    return 0;
+  }
+
+  uint16_t value = reader->data[reader->pos] | (reader->data[reader->pos + 1] << 8);
+  reader->pos += 2;
+  return value;
+}
+
+uint32_t wire_read_u32(WireReader *reader) {
+  if (reader->pos + 4 > reader->length) {
+    reader->error = true;
+    return 0;
+  }
+
+  const uint8_t *bytes = &reader->data[reader->pos];
+  uint32_t value = (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) |
+                   ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+  reader->pos += 4;
+  return value;
+}
+
+WireString wire_read_string(WireReader *reader) {
+  WireString string = {.data = "", .length = 0};
+  uint8_t length = wire_read_u8(reader);
+
+  if (reader->error || reader->pos + length > reader->length) {
+    reader->error = true;
+    return string;
+  }
+
+  string.data = (const char *)&reader->data[reader->pos];
+  string.length = length;
+  reader->pos += length;
+  return string;
+}
+
+void wire_string_copy(WireString string, char *output, size_t output_size) {
+  if (!output || output_size == 0) {
+    return;
+  }
+
+  size_t length = string.length;
+  if (length >= output_size) {
+    length = output_size - 1;
+  }
+
+  memcpy(output, string.data, length);
+  output[length] = '\0';
+}
+
+void wire_read_string_into(WireReader *reader, char *output, size_t output_size) {
+  wire_string_copy(wire_read_string(reader), output, output_size);
+}
+
+ArenaString wire_read_string_arena(WireReader *reader, StringArena *arena) {
+  WireString string = wire_read_string(reader);
+  return string_arena_add(arena, string.data, string.length);
+}
+
+// Clamp a payload's records, continuing from first_index, to max_records
+static int parse_end(int first_index, int record_count, int max_records) {
+  int end = first_index + record_count;
+  return end > max_records ? max_records : end;
+}
+
+// Read records until end or the first truncated one, returning the count
+// reached
+static int parse_range(WireReader *reader, int parsed, int end,
+                       WireRecordHandler handler, void *context) {
+  while (parsed < end) {
+    handler(reader, parsed, context);
+    if (reader->error) {
+      break;
+    }
+    parsed++;
+  }
+  return parsed;
+}
+
+int wire_parse_records(const uint8_t *data, size_t length, WireSchema schema,
+                       int first_index, int max_records,
+                       WireRecordHandler handler, void *context) {
+  WireReader reader;
+  int record_count = 0;
+  if (!wire_reader_init(&reader, data, length, schema, &record_count)) {
+    return -1;
+  }
+
+  return parse_range(&reader, first_index,
+                     parse_end(first_index, record_count, max_records),
+                     handler, context);
+}
+
+bool wire_parse_job_start(WireParseJob *job, uint8_t *data, size_t length,
+                          WireSchema schema, int first_index, int max_records) {
+  int record_count = 0;
+  if (!wire_reader_init(&job->reader, data, length, schema, &record_count)) {
+    free(data);
+    job->data = NULL;
+    return false;
+  }
+
+  job->data = data;
+  job->next_index = first_index;
+  job->end_index = parse_end(first_index, record_count, max_records);
+  return true;
+}
+
+int wire_parse_job_step(WireParseJob *job, int slice,
+                        WireRecordHandler handler, void *context) {
+  if (!job->data) {
+    return job->next_index;
+  }
+
+  int end = job->end_index;
+  if (slice > 0 && job->next_index + slice < end) {
+    end = job->next_index + slice;
+  }
+
+  job->next_index = parse_range(&job->reader, job->next_index, end, handler, context);
+  if (job->reader.error || job->next_index == job->end_index) {
+    wire_parse_job_cancel(job);
+  }
+  return job->next_index;
+}
+
+bool wire_parse_job_done(const WireParseJob *job) {
+  return !job->data;
+}
+
+void wire_parse_job_cancel(WireParseJob *job) {
+  free(job->data);
+  job->data = NULL;
+}
+
+// Walk the ops of a patch, writing into output when it is not NULL. Returns
+// the rebuilt length, or 0 if an op is malformed or reaches outside the base.
+static size_t run_patch(const uint8_t *base, size_t base_length,
+                        const uint8_t *patch, size_t patch_length,
+                        uint8_t *output) {
+  WireReader reader;
+  if (!wire_reader_init(&reader, patch, patch_length, base[0], NULL)) {
+    return 0;
+  }
+
+  size_t length = WIRE_HEADER_SIZE;
+  if (output) {
+    memcpy(output, patch, WIRE_HEADER_SIZE);
+  }
+
+  while (reader.pos < reader.length) {
+    const uint8_t *bytes;
+    size_t count;
+
+    uint8_t op = wire_read_u8(&reader);
+    if (op == WIRE_PATCH_COPY) {
+      size_t offset = wire_read_u16(&reader);
+      count = wire_read_u16(&reader);
+      if (offset < WIRE_HEADER_SIZE || offset + count > base_length) {
+        return 0;
+      }
+      bytes = base + offset;
+    } else if (op == WIRE_PATCH_DATA) {
+      WireString data = wire_read_string(&reader);
+      bytes = (const uint8_t *)data.data;
+      count = data.length;
+    } else {
+      return 0;
+    }
+
+    if (reader.error) {
+      return 0;
+    }
+
+    if (output) {
+      memcpy(output + length, bytes, count);
+    }
+    length += count;
+  }
+
+  return length;
+}
+
+uint8_t *wire_apply_patch(const uint8_t *base, size_t base_length,
+                          const uint8_t *patch, size_t patch_length,
+                          size_t *length) {
+  if (!base || base_length < WIRE_HEADER_SIZE || !length) {
+    return NULL;
+  }
+
+  size_t rebuilt_length = run_patch(base, base_length, patch, patch_length, NULL);
+  if (rebuilt_length == 0) {
+    return NULL;
+  }
+
+  uint8_t *rebuilt = malloc(rebuilt_length);
+  if (!rebuilt) {
+    return NULL;
+  }
+
+  run_patch(base, base_length, patch, patch_length, rebuilt);
+  *length = rebuilt_length;
+  return rebuilt;
+}
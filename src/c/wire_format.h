@@ -0,0 +1,120 @@
+#pragma once
+
+#include "string_arena.h"
+#include <pebble.h>
+
+// Binary payload format shared with src/pkjs/wire_format.js.
+// Every payload starts with a header of [schema id][record count] followed by
+// packed records. Integers are little-endian, strings are a length byte
+// followed by that many UTF-8 bytes without a terminator.
+//
+// A schema id is never reused when its layout changes, so payloads cached by
+// an older build are rejected instead of misread. 5-7 carried whole points.
+typedef enum {
+  WIRE_SCHEMA_OVERVIEW = 1,
+  WIRE_SCHEMA_CALENDAR = 2,
+  WIRE_SCHEMA_RACE_SCHEDULE = 3,
+  WIRE_SCHEMA_DICTIONARY = 4,
+  WIRE_SCHEMA_QUALIFYING_RESULTS = 8,
+  WIRE_SCHEMA_DRIVER_STANDINGS = 9,
+  WIRE_SCHEMA_TEAM_STANDINGS = 10,
+  WIRE_SCHEMA_RACE_RESULTS = 11,
+} WireSchema;
+
+#define WIRE_HEADER_SIZE 2
+
+// A string field viewed in place inside the payload
+typedef struct {
+  const char *data;
+  uint8_t length;
+} WireString;
+
+// Cursor over a payload. Reads past the end set error and return zero values,
+// so callers can read a whole record and check error once.
+typedef struct {
+  const uint8_t *data;
+  size_t length;
+  size_t pos;
+  bool error;
+} WireReader;
+
+// Start reading a payload. Returns false if it is too short or was encoded
+// for a different schema; otherwise record_count receives the record count.
+bool wire_reader_init(WireReader *reader, const uint8_t *data, size_t length,
+                      WireSchema schema, int *record_count);
+
+// Record count a payload announces, or -1 if it was encoded for a different
+// schema. Lets a caller size its storage before parsing.
+int wire_record_count(const uint8_t *data, size_t length, WireSchema schema);
+
+uint8_t wire_read_u8(WireReader *reader);
+uint16_t wire_read_u16(WireReader *reader);
+uint32_t wire_read_u32(WireReader *reader);
+WireString wire_read_string(WireReader *reader);
+
+// Copy a string field into a NUL-terminated buffer, truncating if needed
+void wire_string_copy(WireString string, char *output, size_t output_size);
+
+// Read the next string field straight into a NUL-terminated buffer
+void wire_read_string_into(WireReader *reader, char *output, size_t output_size);
+
+// Read the next string field into an arena, returning its offset
+ArenaString wire_read_string_arena(WireReader *reader, StringArena *arena);
+
+// Called once per record with the reader positioned at its first field.
+// index is the record's position in the whole dataset and can be used as the
+// destination slot; fields should be read directly into it.
+typedef void (*WireRecordHandler)(WireReader *reader, int index, void *context);
+
+// Walk the records of a payload, calling handler for each. first_index is the
+// number of records already held from earlier chunks of the same dataset, so
+// a chunk's records continue from there; pass 0 for a whole payload. Stops at
+// max_records or the first truncated record. Returns the total number of
+// records now held, or -1 if the payload was encoded for a different schema.
+int wire_parse_records(const uint8_t *data, size_t length, WireSchema schema,
+                       int first_index, int max_records,
+                       WireRecordHandler handler, void *context);
+
+// A payload parsed a slice of records at a time, so a large dataset can be
+// spread over several timer ticks instead of blocking one callback
+typedef struct {
+  // Owned by the job and freed once it finishes
+  uint8_t *data;
+  WireReader reader;
+  int next_index;
+  int end_index;
+} WireParseJob;
+
+// Start parsing data, a heap buffer the job takes ownership of. first_index
+// and max_records mean the same as for wire_parse_records. Returns false, and
+// frees data, if it was encoded for a different schema.
+bool wire_parse_job_start(WireParseJob *job, uint8_t *data, size_t length,
+                          WireSchema schema, int first_index, int max_records);
+
+// Parse up to slice more records, or all that remain if slice is 0. Returns
+// the total number of records now held. The job finishes at the last record
+// or the first truncated one.
+int wire_parse_job_step(WireParseJob *job, int slice,
+                        WireRecordHandler handler, void *context);
+
+bool wire_parse_job_done(const WireParseJob *job);
+
+// Drop the rest of the payload
+void wire_parse_job_cancel(WireParseJob *job);
+
+// A patch rebuilds a dataset from the copy the watch already holds. It has
+// the usual header, with the record count of the result, followed by ops:
+//   WIRE_PATCH_COPY: u16 offset, u16 length - bytes taken from the base
+//   WIRE_PATCH_DATA: a length byte and that many new bytes
+// The result is the header followed by the output of each op in turn.
+typedef enum {
+  WIRE_PATCH_COPY = 0,
+  WIRE_PATCH_DATA = 1,
+} WirePatchOp;
+
+// Apply a patch to a base payload of the same schema. Returns a heap buffer
+// the caller must free() holding the rebuilt payload, or NULL if the patch is
+// malformed or does not fit the base. length receives the rebuilt size.
+uint8_t *wire_apply_patch(const uint8_t *base, size_t base_length,
+                          const uint8_t *patch, size_t patch_length,
+                          size_t *length);
@@ -6,11 +6,17 @@ const BASE_URL = 'https://flashback.pages.dev';
 // Number of days to consider a race "upcoming" (configurable)
 // Default ~4 months = 120 days
 const UPCOMING_DAYS = 120;
+// Attempts per chunk before a chunked transfer to the watch is abandoned
+const MAX_CHUNK_ATTEMPTS = 3;
+// Results of a race older than this are settled (penalties and appeals are
+// decided), so they are flagged final and the watch never asks again
+const RESULTS_FINAL_AFTER_MS = 1000 * 60 * 60 * 24 * 7;
 
 // Clay configuration
 var Clay = require('@rebble/clay');
 var clayConfig = require('./config');
 var clay = new Clay(clayConfig);
+var wire = require('./wire_format');
 
 // Import auto-generated message keys
 var messageKeys = require('message_keys');
@@ -23,7 +29,12 @@ const REQUEST_TYPES = {
     GET_DRIVER_STANDINGS: 3,
     GET_TEAM_STANDINGS: 4,
     GET_RACE_RESULTS: 5,
-    GET_QUALIFYING_RESULTS: 6
+    GET_QUALIFYING_RESULTS: 6,
+    GET_CALENDAR: 7,
+    GET_BOOTSTRAP: 8,
+    GET_DICTIONARY: 9,
+    GET_RACE_WEEKEND: 10,
+    CANCEL: 11
 };
 
 // Cache management
@@ -74,9 +85,242 @@ function setCachedData(type, season, content) {
     }
 }
 
+// Rows last delivered to the watch for a dataset, with the hash the watch
+// will report for them, so the next reply can be sent as a patch
+function getDeliveredRows(copyKey) {
+    try {
+        return JSON.parse(localStorage.getItem(`f1_delivered_${copyKey}`));
+    } catch (e) {
+        return null;
+    }
+}
+
+function setDeliveredRows(copyKey, schema, hash, rows) {
+    try {
+        localStorage.setItem(`f1_delivered_${copyKey}`, JSON.stringify({ schema: schema, hash: hash, rows: rows }));
+    } catch (e) {
+        console.error('Error recording delivered rows:', e);
+    }
+}
+
+// Drivers and constructors are sent to the watch once per season in a
+// dictionary and referred to by small ids everywhere else. Ids are kept in
+// localStorage so they stay stable for datasets the watch has cached.
+// Keep in step with MAX_DICTIONARY_ENTRIES in dictionary.c.
+const MAX_DICTIONARY_ENTRIES = 64;
+// Outside the watch's table, so it reads as an unknown name
+const NO_DICTIONARY_ID = 255;
+let dictionary = null;
+
+function loadDictionary() {
+    const season = getCurrentSeason();
+    if (dictionary && dictionary.season === season) {
+        return dictionary;
+    }
+
+    try {
+        dictionary = JSON.parse(localStorage.getItem(`f1_dictionary_${season}`));
+    } catch (e) {
+        dictionary = null;
+    }
+    if (!dictionary || dictionary.season !== season) {
+        dictionary = { season: season, ids: {}, names: [] };
+    }
+    return dictionary;
+}
+
+// Make sure every key a dataset is about to use gets an id. If the season's
+// dictionary cannot fit the new ones, start it again; syncDictionary then
+// sends it as a rewrite.
+function reserveDictionaryIds(keys) {
+    const entries = loadDictionary();
+    const missing = new Set(keys.filter(key => entries.ids[key] === undefined));
+    if (entries.names.length + missing.size <= MAX_DICTIONARY_ENTRIES) {
+        return;
+    }
+
+    console.log(`Dictionary full, starting season ${entries.season} again`);
+    dictionary = { season: entries.season, ids: {}, names: [] };
+}
+
+// Name a driver is shown under everywhere, so one id never alternates
+// between two names
+function driverName(driver, driverId) {
+    return driver && driver.firstName && driver.lastName
+        ? `${driver.firstName} ${driver.lastName}`
+        : driverId;
+}
+
+// Id of a driver ('driver:<id>') or constructor ('team:<id>'), assigning the
+// next free one the first time it is seen. The name is refreshed each time.
+// A key that still does not fit after reserveDictionaryIds gets no id and
+// shows as unknown on the watch.
+function dictionaryId(key, name) {
+    const entries = loadDictionary();
+    let id = entries.ids[key];
+    if (id === undefined) {
+        if (entries.names.length >= MAX_DICTIONARY_ENTRIES) {
+            console.error(`Dictionary full, no id for ${key}`);
+            return NO_DICTIONARY_ID;
+        }
+        id = entries.names.length;
+        entries.ids[key] = id;
+    }
+
+    if (entries.names[id] !== name) {
+        entries.names[id] = name;
+        try {
+            localStorage.setItem(`f1_dictionary_${entries.season}`, JSON.stringify(entries));
+        } catch (e) {
+            console.error('Error saving dictionary:', e);
+        }
+    }
+    return id;
+}
+
+// Datasets that refer to dictionary ids. The watch forgets its copies of
+// them when a new dictionary renames or drops an id (dictionary.c).
+const DICTIONARY_DATASETS = [
+    REQUEST_TYPES.GET_DRIVER_STANDINGS,
+    REQUEST_TYPES.GET_TEAM_STANDINGS,
+    REQUEST_TYPES.GET_RACE_RESULTS,
+    REQUEST_TYPES.GET_QUALIFYING_RESULTS
+];
+
+// Names last sent to the watch, with the hash it reports for them
+function getDeliveredDictionary() {
+    try {
+        return JSON.parse(localStorage.getItem('f1_delivered_dictionary'));
+    } catch (e) {
+        return null;
+    }
+}
+
+// Whether sending names would rename or drop an id the watch holds. If what
+// the watch holds is unknown, assume it does.
+function rewritesWatchDictionary(names) {
+    if (!watchDictionaryHash) {
+        return false;
+    }
+    const delivered = getDeliveredDictionary();
+    if (!delivered || delivered.hash !== watchDictionaryHash) {
+        return true;
+    }
+    return delivered.names.length > names.length ||
+        delivered.names.some((name, id) => name && names[id] !== name);
+}
+
+// Send the dictionary first if the watch's copy is missing or out of date,
+// so every id in the dataset that follows resolves to a name
+function syncDictionary(requestId) {
+    const names = loadDictionary().names;
+    const entries = names.map((name, id) => ({ id: id, name: name }));
+    const chunks = wire.encodeChunks(wire.SCHEMAS.DICTIONARY, entries, (writer, entry) => {
+        writer.u8(entry.id);
+        writer.str(entry.name);
+    });
+    const hash = wire.payloadHash(chunks);
+    if (hash === watchDictionaryHash) {
+        return Promise.resolve();
+    }
+
+    // The watch will drop the datasets that refer to ids, so a reply must not
+    // be a patch or a not-modified against its old copy
+    if (rewritesWatchDictionary(names)) {
+        Object.keys(watchCopies).forEach((copyKey) => {
+            if (DICTIONARY_DATASETS.indexOf(Number(copyKey.split(':')[0])) !== -1) {
+                delete watchCopies[copyKey];
+            }
+        });
+    }
+
+    // Several replies may wait on one dictionary transfer, so it carries no
+    // request id and is not dropped when any one of them is cancelled
+    return shareInFlight(`dictionary_${hash}`, requestId, () =>
+        sendChunksToWatch({
+            REQUEST_TYPE: REQUEST_TYPES.GET_DICTIONARY
+        }, chunks, 'dictionary').then(() => {
+            watchDictionaryHash = hash;
+            try {
+                localStorage.setItem('f1_delivered_dictionary', JSON.stringify({ hash: hash, names: names }));
+            } catch (e) {
+                console.error('Error recording delivered dictionary:', e);
+            }
+        }));
+}
+
+// Watch requests still being answered, by request id, holding the key the
+// request is deduplicated under in pendingRequests
+const activeRequests = {};
+
+// Requests the watch cancelled before their reply was finished. Nothing more
+// is fetched or sent for them.
+const cancelledRequests = {};
+
+function isCancelled(requestId) {
+    return !!(requestId && cancelledRequests[requestId]);
+}
+
+// Fetches currently in progress, keyed like the cache, so concurrent callers
+// share one XHR instead of each starting their own. Each fetch lists the
+// watch requests waiting on it, so the XHR is only aborted once every one of
+// them is cancelled. start receives a function to register its XHR with.
+const inFlightFetches = {};
+
+function shareInFlight(key, requestId, start) {
+    if (isCancelled(requestId)) {
+        return Promise.reject(new Error(`Request ${requestId} cancelled`));
+    }
+
+    let fetch = inFlightFetches[key];
+    if (fetch) {
+        console.log(`Joining in-flight fetch for ${key}`);
+    } else {
+        fetch = { requestIds: [], xhr: null };
+        fetch.promise = start(xhr => {
+            fetch.xhr = xhr;
+        });
+        inFlightFetches[key] = fetch;
+
+        const clear = () => {
+            if (inFlightFetches[key] === fetch) {
+                delete inFlightFetches[key];
+            }
+        };
+        fetch.promise.then(clear, clear);
+    }
+
+    fetch.requestIds.push(requestId);
+    return fetch.promise;
+}
+
+// Stop answering a request the watch no longer wants: abort the fetches only
+// it was waiting on, and make any later send for it fail
+function cancelRequest(requestId) {
+    const requestKey = activeRequests[requestId];
+    if (!requestKey) {
+        console.log(`Request ${requestId} already answered`);
+        return;
+    }
+
+    console.log(`Cancelling request ${requestId} (${requestKey})`);
+    cancelledRequests[requestId] = true;
+    delete pendingRequests[requestKey];
+
+    Object.keys(inFlightFetches).forEach(key => {
+        const fetch = inFlightFetches[key];
+        fetch.requestIds = fetch.requestIds.filter(id => id !== requestId);
+        if (fetch.requestIds.length === 0 && fetch.xhr) {
+            console.log(`Aborting fetch for ${key}`);
+            delete inFlightFetches[key];
+            fetch.xhr.abort();
+        }
+    });
+}
+
 // Fetch data from API
-function fetchOverview(season) {
-    return new Promise((resolve, reject) => {
+function fetchOverview(season, requestId) {
+    return shareInFlight(getCacheKey('overview', season), requestId, track => new Promise((resolve, reject) => {
         // Check cache first
         const cached = getCachedData('overview', season);
         if (cached) {
@@ -90,6 +334,7 @@ function fetchOverview(season) {
 
         var xhr = new XMLHttpRequest();
         xhr.open('GET', url, true);
+        track(xhr);
         xhr.onload = function() {
             if (xhr.status === 200) {
                 try {
@@ -110,8 +355,11 @@ function fetchOverview(season) {
             console.error('Network error');
             reject(new Error('Network error'));
         };
+        xhr.onabort = function() {
+            reject(new Error('Aborted'));
+        };
         xhr.send();
-    });
+    }));
 }
 
 function findRaceEvent(race) {
@@ -136,8 +384,8 @@ function findRaceEvent(race) {
     return race.schedule[race.schedule.length - 1];
 }
 
-function fetchStandings(season) {
-    return new Promise((resolve, reject) => {
+function fetchStandings(season, requestId) {
+    return shareInFlight(getCacheKey('standings', season), requestId, track => new Promise((resolve, reject) => {
         // Check cache first
         const cached = getCachedData('standings', season);
         if (cached) {
@@ -151,6 +399,7 @@ function fetchStandings(season) {
 
         var xhr = new XMLHttpRequest();
         xhr.open('GET', url, true);
+        track(xhr);
         xhr.onload = function() {
             if (xhr.status === 200) {
                 try {
@@ -171,12 +420,144 @@ function fetchStandings(season) {
             console.error('Network error');
             reject(new Error('Network error'));
         };
+        xhr.onabort = function() {
+            reject(new Error('Aborted'));
+        };
         xhr.send();
+    }));
+}
+
+// Send a message to the watch. Resolves once the watch has acknowledged it,
+// so several messages can be paced one after another.
+function sendToWatch(message, description) {
+    if (isCancelled(message.REQUEST_ID)) {
+        return Promise.reject(new Error(`Not sending ${description}: request cancelled`));
+    }
+
+    return new Promise((resolve, reject) => {
+        Pebble.sendAppMessage(message, function () {
+            console.log(`Sent ${description} successfully`);
+            resolve();
+        }, function (e) {
+            console.error(`Failed to send ${description}:`, e);
+            console.error('Error details:', JSON.stringify(e));
+            reject(new Error(`Failed to send ${description}`));
+        });
+    });
+}
+
+// Transfer ids let the watch tell the chunks of one transfer from a stale
+// tail of an earlier one. 0 is never used.
+let nextTransferId = 1;
+
+// Hash of the copy the watch already holds, keyed like pendingRequests by
+// request type and round. Set when a request arrives and used by the reply.
+const watchCopies = {};
+
+// Datasets a bootstrap request covers, in the order the watch lists their
+// hashes (s_bootstrap_parts in message_handler.c)
+const BOOTSTRAP_PARTS = [
+    REQUEST_TYPES.GET_OVERVIEW,
+    REQUEST_TYPES.GET_CALENDAR,
+    REQUEST_TYPES.GET_DRIVER_STANDINGS,
+    REQUEST_TYPES.GET_TEAM_STANDINGS
+];
+
+// Datasets a race weekend request covers, all for its round
+// (s_race_weekend_parts in message_handler.c)
+const RACE_WEEKEND_PARTS = [
+    REQUEST_TYPES.GET_RACE_DETAILS,
+    REQUEST_TYPES.GET_RACE_RESULTS,
+    REQUEST_TYPES.GET_QUALIFYING_RESULTS
+];
+
+const REQUEST_PARTS = {
+    [REQUEST_TYPES.GET_BOOTSTRAP]: BOOTSTRAP_PARTS,
+    [REQUEST_TYPES.GET_RACE_WEEKEND]: RACE_WEEKEND_PARTS
+};
+
+// Hash of the dictionary the watch holds, as reported with its last request
+let watchDictionaryHash = 0;
+
+// The watch lists the hashes of the datasets a request would replace, then
+// the hash of its dictionary
+function rememberWatchCopies(requestType, payload) {
+    const hashes = wire.bytesToHashes(payload.DATA_HASH);
+    if (hashes.length > 0) {
+        watchDictionaryHash = hashes.pop();
+    }
+    const types = REQUEST_PARTS[requestType] || [requestType];
+    types.forEach((type, i) => {
+        const key = `${type}:${payload.DATA_INDEX || 0}`;
+        if (hashes[i]) {
+            watchCopies[key] = hashes[i];
+        } else {
+            delete watchCopies[key];
+        }
     });
 }
 
+// Send an encoded dataset as a chunked transfer. Chunks go one at a time,
+// each only after the watch acknowledged the previous one, and a chunk the
+// watch rejected is resent a couple of times before the transfer is dropped.
+function sendChunksToWatch(message, chunks, description) {
+    // If the watch already holds exactly this dataset, only confirm its hash
+    const copyKey = `${message.REQUEST_TYPE}:${message.DATA_ROUND || 0}`;
+    const watchHash = watchCopies[copyKey];
+    delete watchCopies[copyKey];
+    if (watchHash && watchHash === wire.payloadHash(chunks)) {
+        return sendToWatch(Object.assign({}, message, {
+            DATA_HASH: wire.hashToBytes(watchHash)
+        }), `${description} (not modified)`);
+    }
+
+    const transferId = nextTransferId;
+    nextTransferId = nextTransferId % 255 + 1;
+
+    const sendChunk = (index, attempt) => sendToWatch(Object.assign({}, message, {
+        DATA_PAYLOAD: chunks[index],
+        DATA_TRANSFER: transferId,
+        DATA_CHUNK: index,
+        DATA_COUNT: chunks.length
+    }), `${description} chunk ${index + 1}/${chunks.length}`)
+        .catch(error => {
+            if (attempt >= MAX_CHUNK_ATTEMPTS || isCancelled(message.REQUEST_ID)) {
+                throw error;
+            }
+            return sendChunk(index, attempt + 1);
+        });
+
+    return chunks.reduce((previous, chunk, index) =>
+        previous.then(() => sendChunk(index, 1)), Promise.resolve());
+}
+
+// Send a keyed dataset. If the watch still holds the version we last
+// delivered, send a patch of the rows that changed instead of every row.
+function sendRowsToWatch(message, schema, rows, description) {
+    const chunks = wire.chunkRows(schema, rows);
+    const hash = wire.payloadHash(chunks);
+    const copyKey = `${message.REQUEST_TYPE}:${message.DATA_ROUND || 0}`;
+    const watchHash = watchCopies[copyKey];
+    const delivered = getDeliveredRows(copyKey);
+    const remember = () => setDeliveredRows(copyKey, schema, hash, rows);
+
+    if (watchHash && watchHash !== hash && delivered &&
+        delivered.schema === schema && delivered.hash === watchHash) {
+        const patch = wire.encodePatch(schema, delivered.rows, rows);
+        if (patch.length <= wire.CHUNK_BYTES) {
+            delete watchCopies[copyKey];
+            return sendToWatch(Object.assign({}, message, {
+                DATA_HASH: wire.hashToBytes(watchHash),
+                DATA_PATCH: patch
+            }), `${description} patch (${patch.length} bytes)`).then(remember);
+        }
+    }
+
+    return sendChunksToWatch(message, chunks, description).then(remember);
+}
+
 // Process overview data and send races to watch
-function sendRacesToWatch(overviewData) {
+function sendRacesToWatch(overviewData, requestId) {
     if (!overviewData || !overviewData.data) {
         console.error('Invalid overview data');
         return;
@@ -185,34 +566,28 @@ function sendRacesToWatch(overviewData) {
     const allRaces = Object.values(overviewData.data);
     const races = allRaces
         .slice()
-        .sort((a, b) => a.round - b.round);
+        .sort((a, b) => (a.date < b.date ? -1 : a.date > b.date ? 1 : a.round - b.round));
 
     console.log(`Formatting ${races.length} races`);
 
-    // Build pipe-delimited strings for all races in round order.
-    // Include the date so the watch can decide which race should be pre-selected.
-    const raceLines = races.map(race => {
-        const location = `${race.circuit.city}, ${race.circuit.country}`;
-        return `${race.round}|${race.name}|${location}|${race.date}`;
+    // Encode all races in date order, which the watch relies on to find the
+    // next race by binary search and split the calendar around it.
+    const chunks = wire.encodeChunks(wire.SCHEMAS.CALENDAR, races, (writer, race) => {
+        writer.u8(race.round);
+        writer.str(race.name);
+        writer.str(`${race.circuit.city}, ${race.circuit.country}`);
+        writer.time(race.date);
     });
 
-    const racesText = raceLines.join('\n');
-
-    console.log('Sending all races as a single message');
-    console.log('Races text length:', racesText.length);
+    console.log(`Sending all races in ${chunks.length} chunk(s)`);
 
-    Pebble.sendAppMessage({
-        REQUEST_TYPE: REQUEST_TYPES.GET_OVERVIEW,
-        DATA_TITLE: racesText
-    }, function () {
-        console.log('Sent races successfully');
-    }, function (e) {
-        console.error('Failed to send races:', e);
-        console.error('Error details:', JSON.stringify(e));
-    });
+    return sendChunksToWatch({
+        REQUEST_TYPE: REQUEST_TYPES.GET_CALENDAR,
+        REQUEST_ID: requestId
+    }, chunks, 'races');
 }
 
-function sendOverviewToWatch(overviewData) {
+function sendOverviewToWatch(overviewData, requestId) {
     if (!overviewData || !overviewData.data) {
         console.error('Invalid overview data for dashboard');
         return;
@@ -225,28 +600,27 @@ function sendOverviewToWatch(overviewData) {
         .filter(race => new Date(race.date) >= now)
         .sort((a, b) => new Date(a.date) - new Date(b.date))[0];
 
+    // Still sent without a race, e.g. after the season's last one, so the
+    // watch is not left waiting for it
     if (!upcomingRace) {
-        console.error('No upcoming race found for dashboard');
-        return;
+        console.log('No upcoming race found for dashboard');
     }
 
-    const raceEvent = findRaceEvent(upcomingRace);
-    const date = raceEvent && raceEvent.date ? raceEvent.date : upcomingRace.date;
-    const time = raceEvent && raceEvent.time ? raceEvent.time : '00:00:00Z';
-    const dateTimeStr = `${date}T${time}`;
-    const overviewText = `${upcomingRace.round}|${upcomingRace.name}|${dateTimeStr}`;
+    const chunks = wire.encodeChunks(wire.SCHEMAS.OVERVIEW, upcomingRace ? [upcomingRace] : [], (writer, race) => {
+        const raceEvent = findRaceEvent(race);
+        const date = raceEvent && raceEvent.date ? raceEvent.date : race.date;
+        const time = raceEvent && raceEvent.time ? raceEvent.time : '00:00:00Z';
+        writer.u8(race.round);
+        writer.str(race.name);
+        writer.time(`${date}T${time}`);
+    });
 
-    console.log('Sending dashboard overview as single message');
-    console.log('Overview text length:', overviewText.length);
+    console.log(`Sending dashboard overview in ${chunks.length} chunk(s)`);
 
-    Pebble.sendAppMessage({
-        OVERVIEW: overviewText
-    }, function () {
-        console.log('Sent dashboard overview successfully');
-    }, function (e) {
-        console.error('Failed to send dashboard overview:', e);
-        console.error('Error details:', JSON.stringify(e));
-    });
+    return sendChunksToWatch({
+        REQUEST_TYPE: REQUEST_TYPES.GET_OVERVIEW,
+        REQUEST_ID: requestId
+    }, chunks, 'dashboard overview');
 }
 
 // Abbreviate a full event label to its shorthand code
@@ -263,7 +637,7 @@ function abbreviateEvent(label) {
 }
 
 // Process race details and send events to watch
-function sendRaceDetailsToWatch(overviewData, raceRound) {
+function sendRaceDetailsToWatch(overviewData, raceRound, requestId) {
     if (!overviewData || !overviewData.data) {
         console.error('Invalid overview data');
         return;
@@ -281,32 +655,23 @@ function sendRaceDetailsToWatch(overviewData, raceRound) {
 
     console.log(`Formatting ${events.length} events for ${race.name} (round ${raceRound})`);
 
-    // Build pipe-delimited strings for all events
-    const eventLines = events.map(event => {
+    const chunks = wire.encodeChunks(wire.SCHEMAS.RACE_SCHEDULE, events, (writer, event) => {
+        writer.str(abbreviateEvent(event.label));
         // Combine date and time into ISO format
-        const dateTimeStr = event.date + 'T' + event.time;
-        return `${abbreviateEvent(event.label)}|${dateTimeStr}`;
+        writer.time(event.date + 'T' + event.time);
     });
 
-    const eventsText = eventLines.join('\n');
+    console.log(`Sending race events in ${chunks.length} chunk(s)`);
 
-    console.log('Sending race events as single message');
-    console.log('Events text length:', eventsText.length);
-
-    // Send as a single message with the formatted text
-    Pebble.sendAppMessage({
+    return sendChunksToWatch({
         REQUEST_TYPE: REQUEST_TYPES.GET_RACE_DETAILS,
-        DATA_TITLE: eventsText
-    }, function () {
-        console.log('Sent race events successfully');
-    }, function (e) {
-        console.error('Failed to send race events:', e);
-        console.error('Error details:', JSON.stringify(e));
-    });
+        DATA_ROUND: raceRound,
+        REQUEST_ID: requestId
+    }, chunks, 'race events');
 }
 
 // Process standings data and send driver standings to watch
-function sendDriverStandingsToWatch(standingsData) {
+function sendDriverStandingsToWatch(standingsData, requestId) {
     if (!standingsData || !standingsData.data) {
         console.error('Invalid standings data');
         return;
@@ -324,9 +689,9 @@ function sendDriverStandingsToWatch(standingsData) {
     const standingsArray = Object.values(driverStandings).sort((a, b) => a.position - b.position);
 
     console.log(`Formatting ${standingsArray.length} driver standings as text`);
+    reserveDictionaryIds(standingsArray.map(standing => `driver:${standing.driverId}`));
 
-    // Build a formatted string with all driver standings
-    const lines = [];
+    const rows = [];
     standingsArray.forEach((standing) => {
         const driver = drivers[standing.driverId];
         if (!driver) {
@@ -334,32 +699,30 @@ function sendDriverStandingsToWatch(standingsData) {
             return;
         }
 
-        const fullName = driver.firstName + ' ' + driver.lastName;
-        const code = driver.code || standing.driverId.toUpperCase().substring(0, 3);
-
-        // Format: "position|name|code|points pts"
-        lines.push(`${standing.position}|${fullName}|${code}|${standing.points} pts`);
+        rows.push({
+            key: standing.driverId,
+            position: standing.position,
+            driver: dictionaryId(`driver:${standing.driverId}`, driverName(driver, standing.driverId)),
+            points: pointsInTenths(standing.points)
+        });
     });
 
-    const formattedText = lines.join('\n');
+    const encoded = wire.encodeRows(rows, (writer, row) => {
+        writer.u8(row.position);
+        writer.u8(row.driver);
+        writer.u16(row.points);
+    }, row => row.key);
 
-    console.log('Sending driver standings as single message');
-    console.log('Text length:', formattedText.length);
+    console.log(`Sending ${encoded.length} driver standings`);
 
-    // Send as a single message with the formatted text
-    Pebble.sendAppMessage({
+    return syncDictionary(requestId).then(() => sendRowsToWatch({
         REQUEST_TYPE: REQUEST_TYPES.GET_DRIVER_STANDINGS,
-        DATA_TITLE: formattedText
-    }, function () {
-        console.log('Sent driver standings text successfully');
-    }, function (e) {
-        console.error('Failed to send driver standings:', e);
-        console.error('Error details:', JSON.stringify(e));
-    });
+        REQUEST_ID: requestId
+    }, wire.SCHEMAS.DRIVER_STANDINGS, encoded, 'driver standings'));
 }
 
 // Process standings data and send team standings to watch
-function sendTeamStandingsToWatch(standingsData) {
+function sendTeamStandingsToWatch(standingsData, requestId) {
     if (!standingsData || !standingsData.data) {
         console.error('Invalid standings data');
         return;
@@ -377,9 +740,9 @@ function sendTeamStandingsToWatch(standingsData) {
     const standingsArray = Object.values(constructorStandings).sort((a, b) => a.position - b.position);
 
     console.log(`Formatting ${standingsArray.length} team standings as text`);
+    reserveDictionaryIds(standingsArray.map(standing => `team:${standing.constructorId}`));
 
-    // Build a formatted string with all team standings
-    const lines = [];
+    const rows = [];
     standingsArray.forEach((standing) => {
         const constructor = constructors[standing.constructorId];
         if (!constructor) {
@@ -387,29 +750,30 @@ function sendTeamStandingsToWatch(standingsData) {
             return;
         }
 
-        // Format: "1. Team Name - 123 pts"
-        lines.push(`${standing.position}|${constructor.name}|${standing.points} pts`);
+        rows.push({
+            key: standing.constructorId,
+            position: standing.position,
+            team: dictionaryId(`team:${standing.constructorId}`, constructor.name),
+            points: pointsInTenths(standing.points)
+        });
     });
 
-    const formattedText = lines.join('\n');
+    const encoded = wire.encodeRows(rows, (writer, row) => {
+        writer.u8(row.position);
+        writer.u8(row.team);
+        writer.u16(row.points);
+    }, row => row.key);
 
-    console.log('Sending team standings as single message');
-    console.log('Text length:', formattedText.length);
+    console.log(`Sending ${encoded.length} team standings`);
 
-    // Send as a single message with the formatted text
-    Pebble.sendAppMessage({
+    return syncDictionary(requestId).then(() => sendRowsToWatch({
         REQUEST_TYPE: REQUEST_TYPES.GET_TEAM_STANDINGS,
-        DATA_TITLE: formattedText
-    }, function () {
-        console.log('Sent team standings text successfully');
-    }, function (e) {
-        console.error('Failed to send team standings:', e);
-        console.error('Error details:', JSON.stringify(e));
-    });
+        REQUEST_ID: requestId
+    }, wire.SCHEMAS.TEAM_STANDINGS, encoded, 'team standings'));
 }
 
-function fetchRaceResults(season, raceRound) {
-    return new Promise((resolve, reject) => {
+function fetchRaceResults(season, raceRound, requestId) {
+    return shareInFlight(getCacheKey(`race_results_${raceRound}`, season), requestId, track => new Promise((resolve, reject) => {
         const cacheIdentifier = `race_results_${raceRound}`;
         const cached = getCachedData(cacheIdentifier, season);
         if (cached) {
@@ -422,6 +786,7 @@ function fetchRaceResults(season, raceRound) {
 
         var xhr = new XMLHttpRequest();
         xhr.open('GET', url, true);
+        track(xhr);
         xhr.onload = function() {
             if (xhr.status === 200) {
                 try {
@@ -433,6 +798,10 @@ function fetchRaceResults(season, raceRound) {
                     console.error('Error parsing race results JSON:', e);
                     reject(e);
                 }
+            } else if (xhr.status === 404) {
+                // Nothing published for a race that has not run yet
+                console.log('No race results published for round', raceRound);
+                resolve(null);
             } else {
                 console.error('HTTP error fetching race results:', xhr.status);
                 reject(new Error('HTTP ' + xhr.status));
@@ -442,105 +811,124 @@ function fetchRaceResults(season, raceRound) {
             console.error('Network error');
             reject(new Error('Network error'));
         };
+        xhr.onabort = function() {
+            reject(new Error('Aborted'));
+        };
         xhr.send();
+    }));
+}
+
+// Points are sent in tenths so half points survive the integer encoding
+function pointsInTenths(points) {
+    return Math.round((Number(points) || 0) * 10);
+}
+
+function encodeRaceResults(rows) {
+    return wire.encodeChunks(wire.SCHEMAS.RACE_RESULTS, rows, (writer, row) => {
+        writer.u8(row.position);
+        writer.u8(row.driver);
+        writer.u16(row.points);
     });
 }
 
-function sendRaceResultsToWatch(resultsData, raceRound) {
+function encodeQualifyingResults(rows) {
+    return wire.encodeChunks(wire.SCHEMAS.QUALIFYING_RESULTS, rows, (writer, row) => {
+        writer.u8(row.position);
+        writer.u8(row.driver);
+        writer.str(row.time);
+    });
+}
+
+// Whether a round's results can no longer change
+function isRoundFinal(season, raceRound, requestId) {
+    return fetchOverview(season, requestId)
+        .then(data => {
+            const race = Object.values(data.data || {}).find(r => r.round === raceRound);
+            return !!race && Date.now() - Date.parse(race.date) > RESULTS_FINAL_AFTER_MS;
+        })
+        .catch(() => false);
+}
+
+// Reply header for a round's results; empty results are never final
+function resultsMessage(requestType, raceRound, final, requestId) {
+    const message = {
+        REQUEST_TYPE: requestType,
+        DATA_ROUND: raceRound,
+        REQUEST_ID: requestId
+    };
+    if (final) {
+        message.DATA_FINAL = 1;
+    }
+    return message;
+}
+
+function sendRaceResultsToWatch(resultsData, raceRound, final, requestId) {
     if (!resultsData || !resultsData.data || !resultsData.data.race) {
         console.log('No race results data available for round', raceRound);
 
-        Pebble.sendAppMessage({
+        return sendChunksToWatch({
             REQUEST_TYPE: REQUEST_TYPES.GET_RACE_RESULTS,
-            DATA_TITLE: ''
-        }, function () {
-            console.log('Sent empty race results message');
-        }, function (e) {
-            console.error('Failed to send race results message:', e);
-            console.error('Error details:', JSON.stringify(e));
-        });
-        return;
+            DATA_ROUND: raceRound,
+            REQUEST_ID: requestId
+        }, encodeRaceResults([]), 'empty race results');
     }
 
     const raceResults = resultsData.data.race;
     const drivers = resultsData.data.drivers || {};
+    reserveDictionaryIds(Object.keys(raceResults).map(driverId => `driver:${driverId}`));
 
     const resultsArray = Object.keys(raceResults).map((driverId) => {
         const result = raceResults[driverId];
-        const driver = drivers[driverId] || {};
-        const fullName = driver.firstName && driver.lastName ? `${driver.firstName} ${driver.lastName}` : driverId;
         return {
             position: result.finished || result.gridPos || 0,
-            name: fullName,
-            points: result.points || 0
+            driver: dictionaryId(`driver:${driverId}`, driverName(drivers[driverId], driverId)),
+            points: pointsInTenths(result.points)
         };
     }).filter(item => item.position > 0)
       .sort((a, b) => a.position - b.position);
 
-    const lines = resultsArray.map((item) => `${item.position}|${item.name}|${item.points}`);
-    const formattedText = lines.join('\n');
+    const chunks = encodeRaceResults(resultsArray);
 
-    console.log('Sending race results as single message');
-    console.log('Race results text length:', formattedText.length);
+    console.log(`Sending race results in ${chunks.length} chunk(s)`);
 
-    Pebble.sendAppMessage({
-        REQUEST_TYPE: REQUEST_TYPES.GET_RACE_RESULTS,
-        DATA_TITLE: formattedText
-    }, function () {
-        console.log('Sent race results successfully');
-    }, function (e) {
-        console.error('Failed to send race results:', e);
-        console.error('Error details:', JSON.stringify(e));
-    });
+    return syncDictionary(requestId).then(() => sendChunksToWatch(
+        resultsMessage(REQUEST_TYPES.GET_RACE_RESULTS, raceRound, final && resultsArray.length > 0, requestId),
+        chunks, 'race results'));
 }
 
-function sendQualifyingResultsToWatch(resultsData, raceRound) {
+function sendQualifyingResultsToWatch(resultsData, raceRound, final, requestId) {
     if (!resultsData || !resultsData.data || !resultsData.data.qualifying) {
         console.log('No qualifying data available for round', raceRound);
 
-        Pebble.sendAppMessage({
+        return sendChunksToWatch({
             REQUEST_TYPE: REQUEST_TYPES.GET_QUALIFYING_RESULTS,
-            DATA_QUALIFYING: ''
-        }, function () {
-            console.log('Sent empty qualifying results message');
-        }, function (e) {
-            console.error('Failed to send qualifying results message:', e);
-            console.error('Error details:', JSON.stringify(e));
-        });
-        return;
+            DATA_ROUND: raceRound,
+            REQUEST_ID: requestId
+        }, encodeQualifyingResults([]), 'empty qualifying results');
     }
 
     const qualifyingResults = resultsData.data.qualifying;
     const drivers = resultsData.data.drivers || {};
+    reserveDictionaryIds(Object.keys(qualifyingResults).map(driverId => `driver:${driverId}`));
 
     const resultsArray = Object.keys(qualifyingResults).map((driverId) => {
         const result = qualifyingResults[driverId];
-        const driver = drivers[driverId] || {};
-        const fullName = driver.firstName && driver.lastName ? `${driver.firstName} ${driver.lastName}` : driverId;
         const bestTime = result.q3 || result.q2 || result.q1 || '';
         return {
             position: result.qualified || 0,
-            name: fullName,
+            driver: dictionaryId(`driver:${driverId}`, driverName(drivers[driverId], driverId)),
             time: bestTime
         };
     }).filter(item => item.position > 0)
       .sort((a, b) => a.position - b.position);
 
-    const lines = resultsArray.map((item) => `${item.position}|${item.name}|${item.time}`);
-    const formattedText = lines.join('\n');
+    const chunks = encodeQualifyingResults(resultsArray);
 
-    console.log('Sending qualifying results as single message');
-    console.log('Qualifying results text length:', formattedText.length);
+    console.log(`Sending qualifying results in ${chunks.length} chunk(s)`);
 
-    Pebble.sendAppMessage({
-        REQUEST_TYPE: REQUEST_TYPES.GET_QUALIFYING_RESULTS,
-        DATA_QUALIFYING: formattedText
-    }, function () {
-        console.log('Sent qualifying results successfully');
-    }, function (e) {
-        console.error('Failed to send qualifying results:', e);
-        console.error('Error details:', JSON.stringify(e));
-    });
+    return syncDictionary(requestId).then(() => sendChunksToWatch(
+        resultsMessage(REQUEST_TYPES.GET_QUALIFYING_RESULTS, raceRound, final && resultsArray.length > 0, requestId),
+        chunks, 'qualifying results'));
 }
 
 // Push a single timeline pin to the Rebble timeline API
@@ -647,87 +1035,179 @@ function getCurrentSeason() {
     return new Date().getFullYear();
 }
 
-// Listen for messages from watch
-Pebble.addEventListener('appmessage', function (e) {
-    console.log('Received message from watch');
+// Answer the launch bootstrap: everything reachable from the dashboard, sent
+// one message at a time so each waits for the watch to ack the previous one.
+// Each part carries its own request type and is cached by the watch as usual.
+function sendBootstrapToWatch(season, requestId) {
+    const overview = fetchOverview(season, requestId);
+    const standings = fetchStandings(season, requestId);
+
+    const parts = [
+        () => overview.then(data => sendOverviewToWatch(data, requestId)),
+        () => overview.then(data => sendRacesToWatch(data, requestId)),
+        () => standings.then(data => sendDriverStandingsToWatch(data, requestId)),
+        () => standings.then(data => sendTeamStandingsToWatch(data, requestId))
+    ];
+
+    // A failed part is logged and skipped so the rest still arrive
+    return parts.reduce((chain, sendPart) => chain
+        .then(sendPart)
+        .catch(error => console.error('Failed to send bootstrap part:', error)),
+        Promise.resolve());
+}
 
-    // The payload uses string keys, not numeric keys
-    const payload = e.payload;
-    const requestType = payload.REQUEST_TYPE;
-    const season = getCurrentSeason();
+// Race results and qualifying for a round. A race not yet run has none
+// published, and empty results are sent so the watch can show its no-results
+// page. Any other failure rejects, so the watch retries with backoff.
+function sendRaceResultsReply(season, raceRound, requestId) {
+    return Promise.all([fetchRaceResults(season, raceRound, requestId), isRoundFinal(season, raceRound, requestId)])
+        .then(results => sendRaceResultsToWatch(results[0], raceRound, results[1], requestId))
+        .catch(error => {
+            // Empty results would be cached as current for the session, so
+            // leave a failed fetch unanswered and the watch retries it
+            console.error('Failed to get race results:', error);
+            throw error;
+        });
+}
 
-    console.log('Request type:', requestType);
+function sendQualifyingResultsReply(season, raceRound, requestId) {
+    return Promise.all([fetchRaceResults(season, raceRound, requestId), isRoundFinal(season, raceRound, requestId)])
+        .then(results => sendQualifyingResultsToWatch(results[0], raceRound, results[1], requestId))
+        .catch(error => {
+            console.error('Failed to get qualifying results:', error);
+            throw error;
+        });
+}
+
+// Answer a race weekend request: the round's schedule, race results and
+// qualifying, sent in turn like the bootstrap parts. Both results come from
+// the one race results document, fetched once.
+function sendRaceWeekendToWatch(season, raceRound, requestId) {
+    const overview = fetchOverview(season, requestId);
+
+    const parts = [
+        () => overview.then(data => sendRaceDetailsToWatch(data, raceRound, requestId)),
+        () => sendRaceResultsReply(season, raceRound, requestId),
+        () => sendQualifyingResultsReply(season, raceRound, requestId)
+    ];
+
+    return parts.reduce((chain, sendPart) => chain
+        .then(sendPart)
+        .catch(error => console.error('Failed to send race weekend part:', error)),
+        Promise.resolve());
+}
 
+// Answer a single watch request. Returns a promise that settles once the
+// watch has acknowledged the reply, or null for unknown requests.
+function handleRequest(requestType, payload, season) {
+    const requestId = payload.REQUEST_ID;
     switch (requestType) {
+        case REQUEST_TYPES.GET_BOOTSTRAP:
+            console.log('Request: GET_BOOTSTRAP');
+            return sendBootstrapToWatch(season, requestId);
+
         case REQUEST_TYPES.GET_OVERVIEW:
             console.log('Request: GET_OVERVIEW');
-            fetchOverview(season)
-                .then(data => {
-                    sendOverviewToWatch(data);
-                    sendRacesToWatch(data);
-                })
+            return fetchOverview(season, requestId)
+                .then(data => sendOverviewToWatch(data, requestId))
                 .catch(error => console.error('Failed to get overview:', error));
-            break;
+
+        case REQUEST_TYPES.GET_CALENDAR:
+            console.log('Request: GET_CALENDAR');
+            return fetchOverview(season, requestId)
+                .then(data => sendRacesToWatch(data, requestId))
+                .catch(error => console.error('Failed to get calendar:', error));
 
         case REQUEST_TYPES.GET_RACE_DETAILS: {
             console.log('Request: GET_RACE_DETAILS');
             const raceRound = payload.DATA_INDEX;
             console.log('Race round:', raceRound);
-            fetchOverview(season)
-                .then(data => sendRaceDetailsToWatch(data, raceRound))
+            return fetchOverview(season, requestId)
+                .then(data => sendRaceDetailsToWatch(data, raceRound, requestId))
                 .catch(error => console.error('Failed to get race details:', error));
-            break;
         }
 
         case REQUEST_TYPES.GET_DRIVER_STANDINGS:
             console.log('Request: GET_DRIVER_STANDINGS');
-            fetchStandings(season)
-                .then(data => sendDriverStandingsToWatch(data))
+            return fetchStandings(season, requestId)
+                .then(data => sendDriverStandingsToWatch(data, requestId))
                 .catch(error => console.error('Failed to get driver standings:', error));
-            break;
 
         case REQUEST_TYPES.GET_TEAM_STANDINGS:
             console.log('Request: GET_TEAM_STANDINGS');
-            fetchStandings(season)
-                .then(data => sendTeamStandingsToWatch(data))
+            return fetchStandings(season, requestId)
+                .then(data => sendTeamStandingsToWatch(data, requestId))
                 .catch(error => console.error('Failed to get team standings:', error));
-            break;
+
+        case REQUEST_TYPES.GET_RACE_WEEKEND: {
+            console.log('Request: GET_RACE_WEEKEND');
+            const raceRound = payload.DATA_INDEX;
+            console.log('Race round:', raceRound);
+            return sendRaceWeekendToWatch(season, raceRound, requestId);
+        }
 
         case REQUEST_TYPES.GET_RACE_RESULTS: {
             console.log('Request: GET_RACE_RESULTS');
             const raceRound = payload.DATA_INDEX;
             console.log('Race round:', raceRound);
-            fetchRaceResults(season, raceRound)
-                .then(data => sendRaceResultsToWatch(data, raceRound))
-                .catch(error => {
-                    console.error('Failed to get race results:', error);
-                    // Send empty results to allow app to show the no-results page
-                    Pebble.sendAppMessage({
-                        REQUEST_TYPE: REQUEST_TYPES.GET_RACE_RESULTS,
-                        DATA_TITLE: ''
-                    });
-                });
-            break;
+            return sendRaceResultsReply(season, raceRound, requestId);
         }
 
         case REQUEST_TYPES.GET_QUALIFYING_RESULTS: {
             console.log('Request: GET_QUALIFYING_RESULTS');
             const raceRound = payload.DATA_INDEX;
             console.log('Race round:', raceRound);
-            fetchRaceResults(season, raceRound)
-                .then(data => sendQualifyingResultsToWatch(data, raceRound))
-                .catch(error => {
-                    console.error('Failed to get qualifying results:', error);
-                    Pebble.sendAppMessage({
-                        REQUEST_TYPE: REQUEST_TYPES.GET_QUALIFYING_RESULTS,
-                        DATA_QUALIFYING: ''
-                    });
-                });
-            break;
+            return sendQualifyingResultsReply(season, raceRound, requestId);
         }
 
         default:
             console.log('Unknown request type:', requestType);
+            return null;
+    }
+}
+
+// Watch requests still being answered, keyed by type and index, so a
+// repeated request does not send the same reply twice
+const pendingRequests = {};
+
+// Listen for messages from watch
+Pebble.addEventListener('appmessage', function (e) {
+    console.log('Received message from watch');
+
+    // The payload uses string keys, not numeric keys
+    const payload = e.payload;
+    const requestType = payload.REQUEST_TYPE;
+    const season = getCurrentSeason();
+
+    console.log('Request type:', requestType);
+
+    // A cancel names the superseded request in DATA_INDEX
+    if (requestType === REQUEST_TYPES.CANCEL) {
+        cancelRequest(payload.DATA_INDEX);
+        return;
+    }
+
+    const requestKey = `${requestType}:${payload.DATA_INDEX || 0}`;
+    if (pendingRequests[requestKey]) {
+        console.log(`Ignoring duplicate request ${requestKey}`);
+        return;
+    }
+
+    rememberWatchCopies(requestType, payload);
+    const requestId = payload.REQUEST_ID;
+    const reply = handleRequest(requestType, payload, season);
+    if (reply) {
+        pendingRequests[requestKey] = true;
+        activeRequests[requestId] = requestKey;
+        const clear = () => {
+            // A cancelled request's key may already belong to a newer one
+            if (!isCancelled(requestId)) {
+                delete pendingRequests[requestKey];
+            }
+            delete activeRequests[requestId];
+            delete cancelledRequests[requestId];
+        };
+        reply.then(clear, clear);
     }
 });
 
@@ -0,0 +1,230 @@
+// Binary payload encoding shared with src/c/wire_format.h
+// Layout: [schema id][record count] followed by packed records.
+// Integers are little-endian, strings are a length byte followed by UTF-8 bytes.
+// Times are u32 UTC epoch seconds.
+// Schema ids are never reused when a layout changes (5-7 carried whole points).
+
+const SCHEMAS = {
+    OVERVIEW: 1,
+    CALENDAR: 2,
+    RACE_SCHEDULE: 3,
+    DICTIONARY: 4,
+    QUALIFYING_RESULTS: 8,
+    DRIVER_STANDINGS: 9,
+    TEAM_STANDINGS: 10,
+    RACE_RESULTS: 11
+};
+
+const MAX_RECORDS = 255;
+const MAX_STRING_BYTES = 63;
+
+function utf8Bytes(text) {
+    const encoded = unescape(encodeURIComponent(text || ''));
+    let length = Math.min(encoded.length, MAX_STRING_BYTES);
+
+    // Never cut a multi-byte character in half
+    while (length > 0 && length < encoded.length &&
+           (encoded.charCodeAt(length) & 0xC0) === 0x80) {
+        length--;
+    }
+
+    const bytes = [];
+    for (let i = 0; i < length; i++) {
+        bytes.push(encoded.charCodeAt(i));
+    }
+    return bytes;
+}
+
+function Writer() {
+    this.bytes = [];
+}
+
+Writer.prototype.u8 = function (value) {
+    this.bytes.push(Math.max(0, Math.min(0xFF, Math.floor(value) || 0)));
+};
+
+Writer.prototype.u16 = function (value) {
+    const clamped = Math.max(0, Math.min(0xFFFF, Math.floor(value) || 0));
+    this.bytes.push(clamped & 0xFF, (clamped >> 8) & 0xFF);
+};
+
+Writer.prototype.u32 = function (value) {
+    const clamped = Math.max(0, Math.min(0xFFFFFFFF, Math.floor(value) || 0));
+    this.bytes.push(clamped & 0xFF, (clamped >>> 8) & 0xFF,
+                    (clamped >>> 16) & 0xFF, (clamped >>> 24) & 0xFF);
+};
+
+// Write an ISO date or datetime string as u32 epoch seconds (0 if unparseable).
+// Datetimes without a zone designator are treated as UTC.
+Writer.prototype.time = function (isoString) {
+    let text = isoString || '';
+    if (text.indexOf('T') !== -1 && !/(Z|[+-]\d\d:?\d\d)$/.test(text)) {
+        text += 'Z';
+    }
+    this.u32(Date.parse(text) / 1000);
+};
+
+Writer.prototype.str = function (text) {
+    const bytes = utf8Bytes(text);
+    this.bytes.push(bytes.length);
+    Array.prototype.push.apply(this.bytes, bytes);
+};
+
+// Payload budget per AppMessage. Small enough for every platform's inbox and
+// for the first rows of a long list to reach the watch quickly.
+const CHUNK_BYTES = 512;
+
+function startChunk(schema) {
+    const writer = new Writer();
+    writer.u8(schema);
+    writer.u8(0);
+    return writer;
+}
+
+// Encode each record on its own as { key, bytes }. keyOf(record) identifies
+// a row across versions of a dataset so unchanged rows can be patched in.
+function encodeRows(records, writeRecord, keyOf) {
+    return records.slice(0, MAX_RECORDS).map(record => {
+        const writer = new Writer();
+        writeRecord(writer, record);
+        return { key: keyOf ? keyOf(record) : null, bytes: writer.bytes };
+    });
+}
+
+// Pack encoded rows into a list of byte arrays suitable for byte-array
+// AppMessage tuples. Each chunk is a complete payload holding the next run of
+// records, so the watch can parse chunks as they arrive. There is always at
+// least one chunk, even for no records.
+function chunkRows(schema, rows) {
+    const chunks = [];
+    let writer = startChunk(schema);
+
+    rows.forEach(row => {
+        if (writer.bytes[1] > 0 && writer.bytes.length + row.bytes.length > CHUNK_BYTES) {
+            chunks.push(writer.bytes);
+            writer = startChunk(schema);
+        }
+
+        Array.prototype.push.apply(writer.bytes, row.bytes);
+        writer.bytes[1]++;
+    });
+
+    chunks.push(writer.bytes);
+    return chunks;
+}
+
+// Encode records with writeRecord(writer, record) into payload chunks
+function encodeChunks(schema, records, writeRecord) {
+    return chunkRows(schema, encodeRows(records, writeRecord));
+}
+
+const PATCH_COPY = 0;
+const PATCH_DATA = 1;
+
+// Build a patch that turns the payload made of baseRows into the one made of
+// rows (layout in src/c/wire_format.h). Rows whose key and bytes are
+// unchanged are copied from the watch's copy, runs of them in a single op;
+// everything else is sent as new bytes.
+function encodePatch(schema, baseRows, rows) {
+    const baseOffsets = {};
+    let offset = 2;
+    baseRows.forEach(row => {
+        if (row.key !== null) {
+            baseOffsets[row.key] = { offset: offset, bytes: row.bytes };
+        }
+        offset += row.bytes.length;
+    });
+
+    const writer = new Writer();
+    writer.u8(schema);
+    writer.u8(rows.length);
+
+    let copy = null;
+    let data = [];
+    const flushCopy = () => {
+        if (copy) {
+            writer.u8(PATCH_COPY);
+            writer.u16(copy.offset);
+            writer.u16(copy.length);
+            copy = null;
+        }
+    };
+    const flushData = () => {
+        for (let i = 0; i < data.length; i += 0xFF) {
+            const part = data.slice(i, i + 0xFF);
+            writer.u8(PATCH_DATA);
+            writer.u8(part.length);
+            Array.prototype.push.apply(writer.bytes, part);
+        }
+        data = [];
+    };
+
+    rows.forEach(row => {
+        const base = row.key !== null ? baseOffsets[row.key] : null;
+        const unchanged = base && base.bytes.length === row.bytes.length &&
+            base.bytes.every((byte, i) => byte === row.bytes[i]);
+
+        if (unchanged) {
+            flushData();
+            if (copy && copy.offset + copy.length === base.offset) {
+                copy.length += row.bytes.length;
+            } else {
+                flushCopy();
+                copy = { offset: base.offset, length: row.bytes.length };
+            }
+        } else {
+            flushCopy();
+            Array.prototype.push.apply(data, row.bytes);
+        }
+    });
+
+    flushCopy();
+    flushData();
+    return writer.bytes;
+}
+
+// 32-bit FNV-1a hash of the whole dataset the chunks make up, in the form the
+// watch reassembles and caches it: one header with the total record count,
+// then every record. Matches dataset_cache_payload_hash() on the watch.
+function payloadHash(chunks) {
+    let hash = 0x811C9DC5;
+    const mix = byte => {
+        hash = Math.imul(hash ^ byte, 0x01000193) >>> 0;
+    };
+
+    const total = chunks.reduce((sum, chunk) => sum + chunk[1], 0);
+    mix(chunks[0][0]);
+    mix(total);
+    chunks.forEach(chunk => {
+        for (let i = 2; i < chunk.length; i++) {
+            mix(chunk[i]);
+        }
+    });
+    return hash;
+}
+
+// Hashes travel as little-endian u32s in a byte array
+function hashToBytes(hash) {
+    return [hash & 0xFF, (hash >>> 8) & 0xFF, (hash >>> 16) & 0xFF, (hash >>> 24) & 0xFF];
+}
+
+function bytesToHashes(bytes) {
+    const hashes = [];
+    for (let i = 0; i + 4 <= (bytes || []).length; i += 4) {
+        hashes.push((bytes[i] | (bytes[i + 1] << 8) | (bytes[i + 2] << 16) |
+                     (bytes[i + 3] << 24)) >>> 0);
+    }
+    return hashes;
+}
+
+module.exports = {
+    SCHEMAS: SCHEMAS,
+    CHUNK_BYTES: CHUNK_BYTES,
+    encodeRows: encodeRows,
+    chunkRows: chunkRows,
+    encodeChunks: encodeChunks,
+    encodePatch: encodePatch,
+    payloadHash: payloadHash,
+    hashToBytes: hashToBytes,
+    bytesToHashes: bytesToHashes
+};